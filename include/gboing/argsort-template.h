@@ -0,0 +1,212 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Argsort C metafunctions
+ *
+ * argsort_template() and argsort_ptr_template() compute the sorted order of an
+ * array (as numpy's argsort) without moving or writing to its elements, so it
+ * may be read-only (e.g., a shared mapping).
+ *
+ * They sort indirectly with qsort_template(), but store its index instead of
+ * applying it. When each entry written is a pointer in size, the index is
+ * built and sorted in the caller's array itself and nothing more is allocated
+ * for it. 32-bit indices are written when qsort_def::max_size_bits is 32 or
+ * less (see argsort_index_size()), so that arrays of up to 2^32 - 1 elements
+ * need only half the memory for their order.
+ */
+
+#ifndef _ARGSORT_TEMPLATE_H_
+#define _ARGSORT_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback argsort_index_size function */
+static size_t
+argsort_index_size(const struct qsort_def *def) {
+    return def->max_size_bits && def->max_size_bits <= 32 ? sizeof(uint32_t)
+                                                          : sizeof(uint64_t);
+}
+
+/* fallback context for comparing elements through an index of pointers */
+struct _argsort_ctx {
+    const struct qsort_def *def;
+    void *arg;
+};
+
+/* fallback comparison of the elements two index entries point to */
+static int
+_argsort_compar_r(const void *a, const void *b, void *context) {
+    const struct _argsort_ctx *ctx = context;
+    const struct qsort_def *def = ctx->def;
+    const void *ea = *(void *const *)a;
+    const void *eb = *(void *const *)b;
+
+    if (!!def->compar_r)
+        return def->compar_r(ea, eb, ctx->arg);
+    if (!!def->compar)
+        return def->compar(ea, eb);
+    if (!!def->less_r)
+        return def->less_r(ea, eb, ctx->arg) ? -1
+                                             : def->less_r(eb, ea, ctx->arg);
+    return def->less(ea, eb) ? -1 : def->less(eb, ea);
+}
+
+/* fallback sort of an index of pointers to the elements of pbase */
+static int
+_argsort(const struct qsort_def *def, const void *pbase, size_t n,
+         const void **index, void *arg) {
+    struct _argsort_ctx ctx = {def, arg};
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+        index[i] = (const char *)pbase + i * def->size;
+
+    qsort_r(index, n, sizeof(void *), _argsort_compar_r, &ctx);
+    return 0;
+}
+
+/* fallback argsort_template function */
+static int
+argsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 const void *pbase, size_t n, void *out, void *arg) {
+    const void **index = malloc(n * sizeof(void *));
+    size_t i;
+
+    if (!index)
+        return ENOMEM;
+
+    _argsort(def, pbase, n, index, arg);
+
+    for (i = 0; i < n; ++i) {
+        const size_t k = ((const char *)index[i] - (const char *)pbase)
+                         / def->size;
+
+        if (argsort_index_size(def) == sizeof(uint32_t))
+            ((uint32_t *)out)[i] = (uint32_t)k;
+        else
+            ((uint64_t *)out)[i] = k;
+    }
+
+    free(index);
+    return 0;
+}
+
+/* fallback argsort_ptr_template function */
+static int
+argsort_ptr_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, const void *pbase, size_t n,
+                     const void **out, void *arg) {
+    return _argsort(def, pbase, n, out, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @breif Size of each index argsort_template() writes for a def.
+ *
+ * @return sizeof(uint32_t) if def->max_size_bits is 32 or less, otherwise
+ *         sizeof(uint64_t) (including when it's zero, i.e., the default).
+ */
+static gboing_always_inline size_t
+argsort_index_size(const struct qsort_def *def) {
+    struct qsort_def d = *def;
+
+    _qsort_init_def(&d);
+
+    return _qsort_argsort_index_size(&d);
+}
+
+/**
+ * @brief Run qsort_template() to store the sorted order of pbase in out.
+ */
+static gboing_always_inline gboing_flatten int
+_argsort(const struct qsort_def *def, void *buffer, size_t buf_size,
+         const void *pbase, size_t n, void *out, int kind, void *arg) {
+    struct qsort_def d = *def;
+
+    d._argsort = kind;
+    d._argsort_out = out;
+
+    return qsort_template(&d, buffer, buf_size, (void *)pbase, n, arg);
+}
+
+/**
+ * @breif Store the sorted order of an array as element indices, specialized by
+ *        a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored,
+ * except that the elements are always sorted indirectly.
+ *
+ * @param buffer
+ * (Optional) Temporary memory for qsort_template() to use.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array. It's only read.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param out
+ * Array of n uint32_t or uint64_t (per argsort_index_size()) to receive the
+ * index of each element of pbase in sorted order. For 64-bit indices (and
+ * 64-bit pointers), it should be aligned to __alignof__(void *), as it's
+ * sorted in place.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, ENOMEM if workspace could not be allocated or
+ *         EINVAL if qsort_def::elem_buf is too small to hold an index entry
+ *         (see qsort_def::elem_buf).
+ */
+static gboing_always_inline gboing_flatten int
+argsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 const void *pbase, size_t n, void *out, void *arg) {
+    return _argsort(def, buffer, buf_size, pbase, n, out, _QSORT_ARGSORT_INDEX,
+                    arg);
+}
+
+/**
+ * @breif Store the sorted order of an array as element pointers, specialized
+ *        by a struct qsort_def.
+ *
+ * As argsort_template(), but out receives a pointer to each element. Unless
+ * qsort_def::key_prefix is used, out is itself the index sorted, so nothing
+ * more is allocated for it.
+ *
+ * @return zero on success, ENOMEM if workspace could not be allocated or
+ *         EINVAL if qsort_def::elem_buf is too small to hold an index entry.
+ */
+static gboing_always_inline gboing_flatten int
+argsort_ptr_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, const void *pbase, size_t n,
+                     const void **out, void *arg) {
+    return _argsort(def, buffer, buf_size, pbase, n, (void *)out,
+                    _QSORT_ARGSORT_PTR, arg);
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _ARGSORT_TEMPLATE_H_ */
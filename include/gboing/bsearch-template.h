@@ -0,0 +1,408 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Binary search C metafunctions
+ *
+ * lower_bound_template() and bsearch_template() search an array sorted by
+ * qsort_template() (or anything else ordering it by the same def). The search
+ * halves the range without branching on the comparison (the next half is
+ * picked with a mask), so the only mispredictions are on the loop count, and
+ * the comparison is inlined rather than called through a pointer. Both
+ * candidates for the next comparison are prefetched, as nothing is fetched
+ * speculatively any more.
+ *
+ * For large arrays, each level of a binary search is a likely cache miss.
+ * eytzinger_template() copies a sorted array into Eytzinger (breadth-first)
+ * order, that of an implicit binary tree where the children of the node at
+ * (one-based) position k are at 2k and 2k + 1, as in a binary heap. The nodes
+ * visited by a search are then packed towards the front, and all of a node's
+ * descendants a few levels down are adjacent, so
+ * eytzinger_lower_bound_template() prefetches them while it compares the levels
+ * in between (Khuong & Morin, "Array Layouts for Comparison-Based Searching").
+ * They fit in a cache line, but as the array isn't aligned so that they start
+ * one, both lines they may straddle are prefetched.
+ */
+
+#ifndef _BSEARCH_TEMPLATE_H_
+#define _BSEARCH_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+/* Cache line size for eytzinger_lower_bound_template()'s prefetching. */
+#ifndef BSEARCH_CACHE_LINE
+# define BSEARCH_CACHE_LINE 64
+#endif
+
+#if GCC_VERSION < 40700
+
+/* fallback comparison through whichever function def has */
+static int
+_bsearch_less(const struct qsort_def *def, const void *a, const void *b,
+              void *arg) {
+    if (!!def->less_r)
+        return def->less_r(a, b, arg);
+    if (!!def->less)
+        return def->less(a, b);
+    if (!!def->compar_r)
+        return def->compar_r(a, b, arg) < 0;
+    return def->compar(a, b) < 0;
+}
+
+/* fallback lower_bound_template function */
+static size_t
+lower_bound_template(const struct qsort_def *def, const void *key,
+                     const void *pbase, size_t n, void *arg) {
+    const char *const base = (const char *)pbase;
+    size_t lo = 0;
+
+    while (n) {
+        const size_t half = n / 2;
+
+        if (_bsearch_less(def, &base[(lo + half) * def->size], key, arg)) {
+            lo += half + 1;
+            n -= half + 1;
+        } else
+            n = half;
+    }
+
+    return lo;
+}
+
+/* fallback bsearch_template function */
+static void *
+bsearch_template(const struct qsort_def *def, const void *key,
+                 const void *pbase, size_t n, void *arg) {
+    const size_t i = lower_bound_template(def, key, pbase, n, arg);
+    char *const elem = (char *)pbase + i * def->size;
+
+    if (i == n || _bsearch_less(def, key, elem, arg))
+        return NULL;
+
+    return elem;
+}
+
+/* fallback eytzinger_template function */
+static void
+eytzinger_template(const struct qsort_def *def, void *dest, const void *src,
+                   size_t n) {
+    char *const out = (char *)dest;
+    const char *in = (const char *)src;
+    size_t k = 1;
+    size_t i;
+
+    if (!n)
+        return;
+
+    while (2 * k <= n)
+        k *= 2;
+
+    for (i = 0; i < n; ++i, in += def->size) {
+        if (!!def->elem_copy)
+            def->elem_copy(&out[(k - 1) * def->size], in);
+        else
+            memcpy(&out[(k - 1) * def->size], in, def->size);
+
+        if (2 * k + 1 <= n) {
+            for (k = 2 * k + 1; 2 * k <= n;)
+                k *= 2;
+        } else
+            k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+    }
+}
+
+/* fallback eytzinger_lower_bound_template function */
+static size_t
+eytzinger_lower_bound_template(const struct qsort_def *def, const void *key,
+                               const void *pbase, size_t n, void *arg) {
+    const char *const base = (const char *)pbase;
+    size_t k = 1;
+
+    while (k <= n)
+        k = 2 * k + _bsearch_less(def, &base[(k - 1) * def->size], key, arg);
+
+    k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+
+    return k ? k - 1 : n;
+}
+
+/* fallback eytzinger_bsearch_template function */
+static void *
+eytzinger_bsearch_template(const struct qsort_def *def, const void *key,
+                           const void *pbase, size_t n, void *arg) {
+    const size_t i = eytzinger_lower_bound_template(def, key, pbase, n, arg);
+    char *const elem = (char *)pbase + i * def->size;
+
+    if (i == n || _bsearch_less(def, key, elem, arg))
+        return NULL;
+
+    return elem;
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @brief Validate a def for the search functions and fill in its defaults.
+ */
+static gboing_always_inline void
+_bsearch_init_def(struct qsort_def *d) {
+    _qsort_init_def(d);
+
+    gboing_assert_const(!d->less + !d->compar + !d->less_r + !d->compar_r);
+    gboing_assert_const(d->align);
+    gboing_assert_const(d->size);
+    gboing_assert_msg(!!d->less || !!d->compar || !!d->less_r || !!d->compar_r,
+                      "a less or compar function is required");
+}
+
+/**
+ * @breif Find the first element not less than a key, specialized by a struct
+ *        qsort_def.
+ *
+ * @param def
+ * The template parameters. qsort_def::size, qsort_def::align and the less or
+ * compar function are used.
+ *
+ * @param key
+ * The element to search for (or anything the less or compar function accepts
+ * in its place as either argument).
+ *
+ * @param pbase
+ * Element array, sorted by def.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return index of the first element not less than key, or n if there is none.
+ */
+static gboing_always_inline gboing_flatten size_t
+lower_bound_template(const struct qsort_def *def, const void *key,
+                     const void *pbase, size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const char *const base_ptr = (const char *)pbase;
+    const char *base = base_ptr;
+
+    _bsearch_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    if (!n)
+        return 0;
+
+    /* the answer is always within base[0] through base[n] */
+    while (n > 1) {
+        const size_t half = n / 2;
+        const size_t next = (n - half) / 2;
+        const char *const mid = &base[(half - 1) * d.size];
+        size_t lt;
+
+        /* without a branch to speculate past, fetch both of the next step's
+         * midpoints ahead of time ourselves (there's no next step when n is
+         * 2, and next - 1 would wrap) */
+        if (next) {
+            __builtin_prefetch(&base[(next - 1) * d.size]);
+            __builtin_prefetch(&base[(half + next - 1) * d.size]);
+        }
+
+        /* a mask rather than ?:, which gcc turns back into a branch */
+        lt = _qsort_less(&d, (void *)mid, (void *)key, arg);
+        base += half * d.size & -lt;
+        n -= half;
+    }
+
+    return (size_t)(base - base_ptr) / d.size
+           + _qsort_less(&d, (void *)base, (void *)key, arg);
+}
+
+/**
+ * @breif Find an element equal to a key, specialized by a struct qsort_def.
+ *
+ * As libc's bsearch(), but with the comparison inlined. Parameters are as
+ * lower_bound_template()'s.
+ *
+ * @return pointer to the first element equal to key, or NULL if there is none.
+ */
+static gboing_always_inline gboing_flatten void *
+bsearch_template(const struct qsort_def *def, const void *key,
+                 const void *pbase, size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const size_t i = lower_bound_template(def, key, pbase, n, arg);
+    char *const elem = (char *)pbase + i * d.size;
+
+    _bsearch_init_def(&d);
+
+    if (i == n || _qsort_less(&d, (void *)key, elem, arg))
+        return NULL;
+
+    return elem;
+}
+
+/**
+ * @breif Copy a sorted array into Eytzinger order.
+ *
+ * The sorted order is the in-order traversal of the implicit tree, which is
+ * walked without recursion: the successor of a node is the leftmost node of its
+ * right subtree or, if it has none, the parent of the last ancestor it's in the
+ * left subtree of.
+ *
+ * @param def
+ * The template parameters. qsort_def::size, qsort_def::align and
+ * qsort_def::elem_copy are used.
+ *
+ * @param dest
+ * Array of n elements to write. Must not overlap src.
+ *
+ * @param src
+ * Element array, sorted by def.
+ *
+ * @param n
+ * Number of elements.
+ */
+static gboing_always_inline gboing_flatten void
+eytzinger_template(const struct qsort_def *def, void *dest, const void *src,
+                   size_t n) {
+    struct qsort_def d = *def;
+    char *const out = (char *)dest;
+    const char *in = (const char *)src;
+    size_t k = 1;                   /* one-based position in out */
+    size_t i;
+
+    _qsort_init_def(&d);
+    gboing_assert_const(d.align);
+    gboing_assert_const(d.size);
+    gboing_assert_early(!((uintptr_t)dest & (d.align - 1)));
+    gboing_assert_early(!((uintptr_t)src & (d.align - 1)));
+
+    if (!n)
+        return;
+
+    while (2 * k <= n)
+        k *= 2;
+
+    for (i = 0; i < n; ++i, in += d.size) {
+        _qsort_copy(&d, &out[(k - 1) * d.size], in);
+
+        if (2 * k + 1 <= n) {
+            for (k = 2 * k + 1; 2 * k <= n;)
+                k *= 2;
+        } else
+            k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+    }
+}
+
+/**
+ * @brief Number of descendants a node has on the level prefetched: as many as
+ *        fit in a cache line (a power of two), but at least two.
+ *
+ * For node k (one-based), they are the zero-based elements k * span - 1
+ * through k * span + span - 2.
+ */
+static gboing_always_inline size_t
+_eytzinger_prefetch_span(const struct qsort_def *def) {
+    if (2 * def->size > BSEARCH_CACHE_LINE)
+        return 2;
+
+    return (size_t)1 << _qsort_log2(BSEARCH_CACHE_LINE / def->size);
+}
+
+/**
+ * @breif Find the first element not less than a key in an array in Eytzinger
+ *        order.
+ *
+ * Each step descends left or right by adding the comparison result to the
+ * position, so there's nothing to mispredict but the loop count.
+ *
+ * @param def
+ * The template parameters (see lower_bound_template()).
+ *
+ * @param key
+ * The element to search for.
+ *
+ * @param pbase
+ * Element array, as written by eytzinger_template().
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return index (into pbase) of the first element in sorted order not less
+ *         than key, or n if there is none.
+ */
+static gboing_always_inline gboing_flatten size_t
+eytzinger_lower_bound_template(const struct qsort_def *def, const void *key,
+                               const void *pbase, size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const char *const base = (const char *)pbase;
+    size_t span;
+    size_t k = 1;
+
+    _bsearch_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    span = _eytzinger_prefetch_span(&d);
+    gboing_assert_const(span);
+
+    while (k <= n) {
+        /* The first and last bytes of k's descendants: unless pbase is aligned
+         * just so, they straddle two cache lines. These may be past the end,
+         * which prefetch doesn't mind, but a pointer there would be undefined,
+         * so the addresses are computed as integers. */
+        const uintptr_t first = (uintptr_t)base + (k * span - 1) * d.size;
+
+        __builtin_prefetch((const void *)first);
+        __builtin_prefetch((const void *)(first + span * d.size - 1));
+        k = 2 * k + _qsort_less(&d, (void *)&base[(k - 1) * d.size],
+                                (void *)key, arg);
+    }
+
+    /* back out of the right turns taken since the last left one */
+    k >>= __builtin_ctzll(~(unsigned long long)k) + 1;
+
+    return k ? k - 1 : n;
+}
+
+/**
+ * @breif Find an element equal to a key in an array in Eytzinger order.
+ *
+ * Parameters are as eytzinger_lower_bound_template()'s.
+ *
+ * @return pointer to an element equal to key, or NULL if there is none.
+ */
+static gboing_always_inline gboing_flatten void *
+eytzinger_bsearch_template(const struct qsort_def *def, const void *key,
+                           const void *pbase, size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const size_t i = eytzinger_lower_bound_template(def, key, pbase, n, arg);
+    char *const elem = (char *)pbase + i * d.size;
+
+    _bsearch_init_def(&d);
+
+    if (i == n || _qsort_less(&d, (void *)key, elem, arg))
+        return NULL;
+
+    return elem;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _BSEARCH_TEMPLATE_H_ */
@@ -0,0 +1,511 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif An external merge sort C metafunction
+ *
+ * ext_sort_template() sorts a file of fixed-width binary records that may be
+ * far larger than memory. The input is read with pread() in runs that fill the
+ * memory budget, each run is sorted with qsort_template() and written to an
+ * (unlinked) temporary file. The runs are then merged through a loser tree,
+ * reading each one and writing the output in chunks of the budget divided
+ * evenly among them. Should there be so many runs that the chunks would fall
+ * below EXT_SORT_MIN_CHUNK bytes, groups of runs are first merged into longer
+ * runs in additional passes.
+ *
+ * All file access is sequential and is advertised with posix_fadvise(), and
+ * data that has been consumed is dropped from the page cache so that sorting
+ * a huge file doesn't evict everything else.
+ *
+ * The input and output may be the same file, since all of the input has been
+ * read by the time the first record is written.
+ */
+
+#ifndef _EXT_SORT_TEMPLATE_H_
+#define _EXT_SORT_TEMPLATE_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gboing/qsort-template.h>
+
+/* Memory budget used when none is given. */
+#ifndef EXT_SORT_DEFAULT_BUDGET
+# define EXT_SORT_DEFAULT_BUDGET ((size_t)1 << 28)
+#endif
+
+/* Smallest chunk of a run to read at once while merging. */
+#ifndef EXT_SORT_MIN_CHUNK
+# define EXT_SORT_MIN_CHUNK ((size_t)1 << 20)
+#endif
+
+#if GCC_VERSION < 40700
+
+/* fallback ext_sort_template function */
+static int
+ext_sort_template(const struct qsort_def *def, int in_fd, int out_fd,
+                  const char *tmp_dir, size_t budget, void *arg) {
+    return ENOSYS;
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/* A sorted run being read back for merging. */
+struct _ext_run {
+    off_t pos;                      /* next byte of the file to read */
+    off_t end;                      /* end of the run in the file */
+    char *buf;
+    char *cur;                      /* head of the run */
+    char *lim;                      /* end of data in buf */
+};
+
+/**
+ * @brief Read exactly len bytes at off.
+ *
+ * @return zero on success, otherwise an errno value (EIO at end of file).
+ */
+static gboing_unused int
+_ext_pread(int fd, void *buf, size_t len, off_t off) {
+    char *p = buf;
+
+    while (len) {
+        const ssize_t ret = pread(fd, p, len, off);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+
+        if (!ret)
+            return EIO;
+
+        p += ret;
+        off += ret;
+        len -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Write exactly len bytes at off.
+ *
+ * @return zero on success, otherwise an errno value.
+ */
+static gboing_unused int
+_ext_pwrite(int fd, const void *buf, size_t len, off_t off) {
+    const char *p = buf;
+
+    while (len) {
+        const ssize_t ret = pwrite(fd, p, len, off);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+
+        p += ret;
+        off += ret;
+        len -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Create an unlinked temporary file in dir (or P_tmpdir if NULL).
+ *
+ * @return a file descriptor or -1 with errno set.
+ */
+static gboing_unused int
+_ext_tmpfile(const char *dir) {
+    char path[4096];
+    int fd;
+
+    if (snprintf(path, sizeof(path), "%s/gboing-sort-XXXXXX",
+                 dir ? dir : P_tmpdir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return fd;
+}
+
+/**
+ * @brief Read the next chunk of a run into its buffer, leaving cur == lim if
+ *        the run is exhausted.
+ *
+ * @return zero on success, otherwise an errno value.
+ */
+static gboing_unused int
+_ext_run_fill(int fd, struct _ext_run *run, size_t chunk) {
+    const size_t len = (size_t)gboing_min((off_t)chunk, run->end - run->pos);
+    int ret;
+
+    run->cur = run->lim = run->buf;
+    if (!len)
+        return 0;
+
+    ret = _ext_pread(fd, run->buf, len, run->pos);
+    if (ret)
+        return ret;
+
+    /* it won't be read again */
+    posix_fadvise(fd, run->pos, len, POSIX_FADV_DONTNEED);
+
+    run->pos += len;
+    run->lim = run->buf + len;
+
+    return 0;
+}
+
+/**
+ * @brief Determine if the head of run a is to be output before that of run b.
+ *
+ * Exhausted runs lose to everything.
+ */
+static gboing_always_inline int
+_ext_beats(const struct qsort_def *def, const struct _ext_run *runs, size_t a,
+           size_t b, void *arg) {
+    if (runs[a].cur == runs[a].lim)
+        return 0;
+
+    if (runs[b].cur == runs[b].lim)
+        return 1;
+
+    return !_qsort_less(def, runs[b].cur, runs[a].cur, arg);
+}
+
+/**
+ * @brief Merge k consecutive runs of in_fd into one run of out_fd.
+ *
+ * @param def         the template parameters
+ * @param in_fd       file holding the runs
+ * @param starts      k + 1 offsets: the start of each run and the end of the
+ *                    last
+ * @param k           number of runs
+ * @param out_fd      file to write to
+ * @param out_pos     offset in out_fd to write to
+ * @param mem         k + 1 buffers of chunk bytes
+ * @param chunk       bytes per buffer, a multiple of def->size
+ * @param runs        k run descriptors
+ * @param tree        3 * k entries for the loser tree
+ * @param arg         context for less_r/compar_r
+ *
+ * @return zero on success, otherwise an errno value.
+ */
+static gboing_always_inline gboing_flatten int
+_ext_merge(const struct qsort_def *def, int in_fd, const off_t *starts,
+           size_t k, int out_fd, off_t out_pos, char *mem, size_t chunk,
+           struct _ext_run *runs, size_t *tree, void *arg) {
+    const size_t size = def->size;
+    size_t *const win = tree + k;   /* winners while building, 2k entries */
+    char *const out = mem + k * chunk;
+    char *out_cur = out;
+    size_t i;
+    int ret;
+
+    for (i = 0; i < k; ++i) {
+        runs[i].pos = starts[i];
+        runs[i].end = starts[i + 1];
+        runs[i].buf = mem + i * chunk;
+
+        ret = _ext_run_fill(in_fd, &runs[i], chunk);
+        if (ret)
+            return ret;
+
+        win[k + i] = i;
+    }
+
+    /* tree[node] holds the loser of the match at node and tree[0] the
+     * overall winner; the leaf of run i is node k + i */
+    for (i = k; --i;) {
+        const size_t a = win[2 * i];
+        const size_t b = win[2 * i + 1];
+
+        if (_ext_beats(def, runs, a, b, arg)) {
+            win[i] = a;
+            tree[i] = b;
+        } else {
+            win[i] = b;
+            tree[i] = a;
+        }
+    }
+    tree[0] = win[1];
+
+    for (;;) {
+        size_t w = tree[0];
+        size_t node;
+
+        /* when the winner is exhausted, so are the rest */
+        if (runs[w].cur == runs[w].lim)
+            break;
+
+        _qsort_copy(def, out_cur, runs[w].cur);
+        out_cur += size;
+        runs[w].cur += size;
+
+        if (out_cur == out + chunk) {
+            ret = _ext_pwrite(out_fd, out, chunk, out_pos);
+            if (ret)
+                return ret;
+
+            out_pos += chunk;
+            out_cur = out;
+        }
+
+        if (runs[w].cur == runs[w].lim) {
+            ret = _ext_run_fill(in_fd, &runs[w], chunk);
+            if (ret)
+                return ret;
+        }
+
+        /* replay the matches on the path from w's leaf to the root */
+        for (node = (k + w) / 2; node; node /= 2) {
+            if (_ext_beats(def, runs, tree[node], w, arg)) {
+                const size_t loser = w;
+
+                w = tree[node];
+                tree[node] = loser;
+            }
+        }
+        tree[0] = w;
+    }
+
+    return _ext_pwrite(out_fd, out, (size_t)(out_cur - out), out_pos);
+}
+
+/**
+ * @breif External merge sort specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored.
+ *
+ * @param in_fd
+ * File of records of qsort_def::size bytes to sort. Its size must be a
+ * multiple of qsort_def::size.
+ *
+ * @param out_fd
+ * File to write the sorted records to, starting at offset zero. It is then
+ * truncated to their size. It may be in_fd.
+ *
+ * @param tmp_dir
+ * Directory to hold temporary files, or NULL for P_tmpdir. Up to twice the
+ * size of the input may be needed.
+ *
+ * @param budget
+ * Number of bytes of memory to use for runs and buffers, or zero for
+ * EXT_SORT_DEFAULT_BUDGET. This doesn't include qsort_template()'s own
+ * (small) workspace, but does include the index it uses for large elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, EINVAL if the input isn't a whole number of
+ *         records, ENOMEM if memory could not be allocated or the errno value
+ *         of a failed I/O call.
+ */
+static gboing_always_inline gboing_flatten int
+ext_sort_template(const struct qsort_def *def, int in_fd, int out_fd,
+                  const char *tmp_dir, size_t budget, void *arg) {
+    struct qsort_def d = *def;
+    const size_t size = d.size;
+    const int indirect = _qsort_is_indirect(&d);            /* ct const */
+    const size_t index_entry = d.key_prefix ? sizeof(struct _qsort_prefixed)
+                                            : sizeof(void *);
+    const size_t per_elem = size + (indirect ? index_entry : 0);
+    const size_t work_align = gboing_max(gboing_max(d.align, sizeof(void *)),
+                                         gboing_alignof(struct _qsort_prefixed));
+    struct stat st;
+    struct _ext_run *runs = NULL;
+    size_t *tree = NULL;
+    off_t *starts = NULL;
+    struct _qsort_ws ws;
+    char *mem = NULL;
+    char *work = NULL;
+    size_t mem_offset = 0;
+    size_t work_offset = 0;
+    size_t work_size;
+    size_t mem_elems;
+    size_t run_elems;
+    size_t nruns;
+    size_t fan_in;
+    size_t chunk;
+    size_t n;
+    size_t i;
+    int fds[2] = {-1, -1};
+    int ret = 0;
+
+    _qsort_init_def(&d);
+
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+
+    if (fstat(in_fd, &st))
+        return errno;
+
+    if (st.st_size % size)
+        return EINVAL;
+
+    n = (size_t)st.st_size / size;
+    if (!n)
+        return ftruncate(out_fd, 0) ? errno : 0;
+
+    if (!budget)
+        budget = EXT_SORT_DEFAULT_BUDGET;
+
+    run_elems = gboing_min(gboing_max(budget / per_elem, (size_t)1), n);
+    nruns = (n + run_elems - 1) / run_elems;
+
+    /* the same memory holds a run and later the merge buffers, of which there
+     * must be at least three */
+    mem_elems = gboing_max(run_elems, (size_t)3);
+    fan_in = gboing_min(gboing_max(mem_elems * size / EXT_SORT_MIN_CHUNK,
+                                   (size_t)3) - 1, mem_elems - 1);
+    fan_in = gboing_min(fan_in, nruns);
+    chunk = mem_elems / (fan_in + 1) * size;
+
+    /* qsort_template()'s workspace (element buffer, stack and any index) is
+     * supplied, since it would otherwise be put on the stack anew for each
+     * run and only released when we return */
+    work_size = size + gboing_alignof(stack_node) + _qsort_stack_size(&d)
+              + (indirect ? work_align + run_elems * index_entry : 0);
+    work_size = (work_size + work_align - 1) / work_align * work_align;
+
+    /* both go in one heap block */
+    _qsort_ws_init(&ws, NULL, 0, 0);
+    _qsort_ws_place(&ws, mem_elems * size, d.align, &mem_offset);
+    _qsort_ws_place(&ws, work_size, work_align, &work_offset);
+
+    if (!_qsort_ws_alloc(&ws, d.aligned_alloc)) {
+        mem = _qsort_ws_heap(&ws, mem_offset);
+        work = _qsort_ws_heap(&ws, work_offset);
+    }
+
+    runs = malloc(sizeof(*runs) * fan_in);
+    tree = malloc(sizeof(*tree) * 3 * fan_in);
+    starts = malloc(sizeof(*starts) * (nruns + 1));
+
+    if (!mem || !work || !runs || !tree || !starts) {
+        ret = ENOMEM;
+        goto out;
+    }
+
+    posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (nruns > 1) {
+        fds[0] = _ext_tmpfile(tmp_dir);
+        if (fds[0] < 0) {
+            ret = errno;
+            goto out;
+        }
+    }
+
+    /* ==== Sort each run ==== */
+    for (i = 0; i < nruns; ++i) {
+        const off_t pos = (off_t)(i * run_elems * size);
+        const size_t count = gboing_min(run_elems, n - i * run_elems);
+
+        starts[i] = pos;
+
+        ret = _ext_pread(in_fd, mem, count * size, pos);
+        if (ret)
+            goto out;
+
+        posix_fadvise(in_fd, pos, count * size, POSIX_FADV_DONTNEED);
+
+        ret = qsort_template(def, work, work_size, mem, count, arg);
+        if (ret)
+            goto out;
+
+        ret = _ext_pwrite(nruns > 1 ? fds[0] : out_fd, mem, count * size, pos);
+        if (ret)
+            goto out;
+    }
+    starts[nruns] = (off_t)(n * size);
+
+    /* ==== Merge groups of runs until one pass can merge them all ==== */
+    while (nruns > fan_in) {
+        size_t merged = 0;
+        int tmp;
+
+        if (fds[1] < 0) {
+            fds[1] = _ext_tmpfile(tmp_dir);
+            if (fds[1] < 0) {
+                ret = errno;
+                goto out;
+            }
+        }
+
+        /* merged runs keep the offsets of their first run */
+        for (i = 0; i < nruns; i += fan_in) {
+            const size_t k = gboing_min(fan_in, nruns - i);
+
+            ret = _ext_merge(&d, fds[0], starts + i, k, fds[1], starts[i],
+                             mem, chunk, runs, tree, arg);
+            if (ret)
+                goto out;
+
+            starts[merged++] = starts[i];
+        }
+
+        starts[merged] = starts[nruns];
+        nruns = merged;
+
+        tmp = fds[0];
+        fds[0] = fds[1];
+        fds[1] = tmp;
+    }
+
+    if (nruns > 1)
+        ret = _ext_merge(&d, fds[0], starts, nruns, out_fd, 0, mem, chunk,
+                         runs, tree, arg);
+
+    /* drop whatever out_fd held past the sorted records */
+    if (!ret && ftruncate(out_fd, (off_t)(n * size)))
+        ret = errno;
+
+out:
+    for (i = 0; i < 2; ++i)
+        if (fds[i] >= 0)
+            close(fds[i]);
+
+    free(starts);
+    free(tree);
+    free(runs);
+
+    _qsort_ws_free(&ws, d.free);
+
+    return ret;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _EXT_SORT_TEMPLATE_H_ */
@@ -0,0 +1,393 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Binary and d-ary heap (priority queue) C metafunctions
+ *
+ * These maintain a max heap (the greatest element, per the def's less or compar
+ * function, at index zero) in a caller-owned array, as C++'s make_heap,
+ * push_heap and pop_heap do. A min heap is had by reversing the comparison.
+ * Each takes a struct qsort_def, so element size, alignment, the comparison
+ * and qsort_def::heap_arity fold into the code exactly as in qsort_template().
+ *
+ * Elements are moved through a hole rather than swapped: the element being
+ * placed is held in qsort_def::elem_buf and each one passed over takes a
+ * single copy. As these are called once per element pushed or popped,
+ * allocating that buffer each time would cost more than the operation itself,
+ * so the caller must supply it.
+ *
+ * To keep the k smallest of a stream (top-k): heapify_template() the first k,
+ * then heap_replace_top_template() with each further element that is less
+ * than the top.
+ */
+
+#ifndef _HEAP_TEMPLATE_H_
+#define _HEAP_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback comparison through whichever function def has */
+static int
+_heap_less(const struct qsort_def *def, const void *a, const void *b,
+           void *arg) {
+    if (!!def->less_r)
+        return def->less_r(a, b, arg);
+    if (!!def->less)
+        return def->less(a, b);
+    if (!!def->compar_r)
+        return def->compar_r(a, b, arg) < 0;
+    return def->compar(a, b) < 0;
+}
+
+/* fallback element copy */
+static void
+_heap_copy(const struct qsort_def *def, void *dest, const void *src) {
+    if (!!def->elem_copy)
+        def->elem_copy(dest, src);
+    else
+        memcpy(dest, src, def->size);
+}
+
+/* fallback sift down of def->elem_buf into a binary heap from root */
+static void
+_heap_sift_down(const struct qsort_def *def, char *base, size_t root,
+                size_t n, void *arg) {
+    const size_t size = def->size;
+    size_t child;
+
+    while ((child = 2 * root + 1) < n) {
+        if (child + 1 < n && _heap_less(def, &base[child * size],
+                                        &base[(child + 1) * size], arg))
+            ++child;
+
+        if (!_heap_less(def, def->elem_buf, &base[child * size], arg))
+            break;
+
+        _heap_copy(def, &base[root * size], &base[child * size]);
+        root = child;
+    }
+
+    _heap_copy(def, &base[root * size], def->elem_buf);
+}
+
+/* fallback heapify_template function -- qsort_def::heap_arity is ignored */
+static void
+heapify_template(const struct qsort_def *def, void *const pbase, size_t n,
+                 void *arg) {
+    char *const base = (char *)pbase;
+    size_t i;
+
+    for (i = n / 2; i--;) {
+        _heap_copy(def, def->elem_buf, &base[i * def->size]);
+        _heap_sift_down(def, base, i, n, arg);
+    }
+}
+
+/* fallback heap_push_template function */
+static void
+heap_push_template(const struct qsort_def *def, void *const pbase, size_t n,
+                   void *arg) {
+    const size_t size = def->size;
+    char *const base = (char *)pbase;
+    size_t i;
+
+    if (n < 2)
+        return;
+
+    _heap_copy(def, def->elem_buf, &base[(n - 1) * size]);
+
+    for (i = n - 1; i && _heap_less(def, &base[(i - 1) / 2 * size],
+                                     def->elem_buf, arg); i = (i - 1) / 2)
+        _heap_copy(def, &base[i * size], &base[(i - 1) / 2 * size]);
+
+    _heap_copy(def, &base[i * size], def->elem_buf);
+}
+
+/* fallback heap_pop_template function */
+static void
+heap_pop_template(const struct qsort_def *def, void *const pbase, size_t n,
+                  void *arg) {
+    char *const base = (char *)pbase;
+    char *last;
+
+    if (n < 2)
+        return;
+
+    last = &base[(n - 1) * def->size];
+    _heap_copy(def, def->elem_buf, last);
+    _heap_copy(def, last, base);
+    _heap_sift_down(def, base, 0, n - 1, arg);
+}
+
+/* fallback heap_replace_top_template function */
+static void
+heap_replace_top_template(const struct qsort_def *def, void *const pbase,
+                          size_t n, const void *elem, void *arg) {
+    _heap_copy(def, def->elem_buf, elem);
+    _heap_sift_down(def, (char *)pbase, 0, n, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @brief Validate a def for the heap functions and fill in its defaults.
+ */
+static gboing_always_inline void
+_heap_init_def(struct qsort_def *d) {
+    _qsort_init_def(d);
+
+    if (!d->heap_arity)
+        d->heap_arity = 2;
+
+    gboing_assert_const(!d->less + !d->compar + !d->less_r + !d->compar_r);
+    gboing_assert_const(d->align);
+    gboing_assert_const(d->size);
+    gboing_assert_const(d->heap_arity);
+    gboing_assert_msg(!!d->less || !!d->compar || !!d->less_r || !!d->compar_r,
+                      "a less or compar function is required");
+    gboing_assert_msg(d->heap_arity >= 2, "heap_arity must be at least 2");
+    assert(d->elem_buf);
+
+    d->elem_buf = gboing_assume_aligned(d->elem_buf, d->align);
+}
+
+/**
+ * @brief Find the greatest of the children first through end - 1.
+ *
+ * A node with a full set of children gets a loop of qsort_def::heap_arity
+ * iterations, which is a constant and can be unrolled.
+ */
+static gboing_always_inline gboing_flatten size_t
+_heap_max_child(const struct qsort_def *def, char *base, size_t first,
+                size_t end, void *arg) {
+    const size_t size = def->size;
+    size_t max = first;
+    size_t i;
+
+    if (gboing_likely(end - first >= def->heap_arity)) {
+        for (i = 1; i < def->heap_arity; ++i)
+            if (_qsort_less(def, &base[max * size],
+                            &base[(first + i) * size], arg))
+                max = first + i;
+    } else {
+        for (i = first + 1; i < end; ++i)
+            if (_qsort_less(def, &base[max * size], &base[i * size], arg))
+                max = i;
+    }
+
+    return max;
+}
+
+/**
+ * @brief Sift the element held in def->elem_buf down from the hole at root.
+ *
+ * @param def         the template parameters
+ * @param base        first element of the heap
+ * @param root        index of the hole
+ * @param n           number of elements in the heap
+ * @param arg         context for less_r/compar_r
+ */
+static gboing_always_inline gboing_flatten void
+_heap_sift_down(const struct qsort_def *def, char *base, size_t root,
+                size_t n, void *arg) {
+    const size_t size = def->size;
+    size_t first;
+
+    while ((first = root * def->heap_arity + 1) < n) {
+        const size_t child = _heap_max_child(def, base, first, n, arg);
+
+        if (!_qsort_less(def, def->elem_buf, &base[child * size], arg))
+            break;
+
+        _qsort_copy(def, &base[root * size], &base[child * size]);
+        root = child;
+    }
+
+    _qsort_copy(def, &base[root * size], def->elem_buf);
+}
+
+/**
+ * @brief Sift the element held in def->elem_buf up from the hole at i.
+ */
+static gboing_always_inline gboing_flatten void
+_heap_sift_up(const struct qsort_def *def, char *base, size_t i, void *arg) {
+    const size_t size = def->size;
+
+    while (i) {
+        const size_t parent = (i - 1) / def->heap_arity;
+
+        if (!_qsort_less(def, &base[parent * size], def->elem_buf, arg))
+            break;
+
+        _qsort_copy(def, &base[i * size], &base[parent * size]);
+        i = parent;
+    }
+
+    _qsort_copy(def, &base[i * size], def->elem_buf);
+}
+
+/**
+ * @breif Arrange an array into a heap, specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. qsort_def::size, qsort_def::align, the less or
+ * compar function, qsort_def::elem_copy and qsort_def::heap_arity are used;
+ * qsort_def::elem_buf is required.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ */
+static gboing_always_inline gboing_flatten void
+heapify_template(const struct qsort_def *def, void *const pbase, size_t n,
+                 void *arg) {
+    struct qsort_def d = *def;
+    char *const base = (char *)pbase;
+    size_t i;
+
+    _heap_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    if (n < 2)
+        return;
+
+    /* from the last node with children back to the root */
+    for (i = (n - 2) / d.heap_arity + 1; i--;) {
+        _qsort_copy(&d, d.elem_buf, &base[i * d.size]);
+        _heap_sift_down(&d, base, i, n, arg);
+    }
+}
+
+/**
+ * @breif Add the last element of an array to the heap before it.
+ *
+ * @param def
+ * The template parameters (see heapify_template()).
+ *
+ * @param pbase
+ * Element array, of which the first n - 1 are a heap and the last is the
+ * element to add.
+ *
+ * @param n
+ * Number of elements, including the one added.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ */
+static gboing_always_inline gboing_flatten void
+heap_push_template(const struct qsort_def *def, void *const pbase, size_t n,
+                   void *arg) {
+    struct qsort_def d = *def;
+    char *const base = (char *)pbase;
+
+    _heap_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    if (n < 2)
+        return;
+
+    _qsort_copy(&d, d.elem_buf, &base[(n - 1) * d.size]);
+    _heap_sift_up(&d, base, n - 1, arg);
+}
+
+/**
+ * @breif Move the top of a heap to its end.
+ *
+ * On return, the greatest element is at index n - 1 and the first n - 1
+ * elements are a heap.
+ *
+ * @param def
+ * The template parameters (see heapify_template()).
+ *
+ * @param pbase
+ * Element array, which must be a heap.
+ *
+ * @param n
+ * Number of elements in the heap.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ */
+static gboing_always_inline gboing_flatten void
+heap_pop_template(const struct qsort_def *def, void *const pbase, size_t n,
+                  void *arg) {
+    struct qsort_def d = *def;
+    char *const base = (char *)pbase;
+    char *last;
+
+    _heap_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    if (n < 2)
+        return;
+
+    last = &base[(n - 1) * d.size];
+
+    /* the last element is re-inserted from the root's hole */
+    _qsort_copy(&d, d.elem_buf, last);
+    _qsort_copy(&d, last, base);
+    _heap_sift_down(&d, base, 0, n - 1, arg);
+}
+
+/**
+ * @breif Replace the top of a heap with another element.
+ *
+ * This is a pop followed by a push, but sifts down only once.
+ *
+ * @param def
+ * The template parameters (see heapify_template()).
+ *
+ * @param pbase
+ * Element array, which must be a heap.
+ *
+ * @param n
+ * Number of elements in the heap, at least one.
+ *
+ * @param elem
+ * The element to copy in. The top is overwritten, so copy it out first if it's
+ * needed. elem may point into the heap.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ */
+static gboing_always_inline gboing_flatten void
+heap_replace_top_template(const struct qsort_def *def, void *const pbase,
+                          size_t n, const void *elem, void *arg) {
+    struct qsort_def d = *def;
+
+    _heap_init_def(&d);
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+    assert(n);
+
+    _qsort_copy(&d, d.elem_buf, elem);
+    _heap_sift_down(&d, (char *)pbase, 0, n, arg);
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _HEAP_TEMPLATE_H_ */
@@ -0,0 +1,504 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Two-way and k-way merge C metafunctions
+ *
+ * merge_template() merges two sorted arrays and merge_k_template() any number
+ * of them through a loser tree (as ext_sort_template() merges its runs), which
+ * costs log2(k) comparisons per element. Both are stable: of equal elements,
+ * those of earlier inputs come first.
+ *
+ * Output goes to a caller-supplied buffer (struct merge_out). That buffer may
+ * hold the whole result or, with a flush function, be a block that is handed
+ * to it each time it fills, so a merge can feed a file or socket without the
+ * result ever being in memory all at once.
+ */
+
+#ifndef _MERGE_TEMPLATE_H_
+#define _MERGE_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+/* A sorted input to merge_k_template(). */
+struct merge_run {
+    const void *base;
+    size_t n;
+};
+
+/**
+ * @brief Where merged elements go.
+ *
+ * @var merge_out::buf
+ * Output buffer, aligned to qsort_def::align. It must not overlap the inputs.
+ *
+ * @var merge_out::n
+ * Capacity of buf in elements. Without a flush function, this must be enough
+ * for the whole result.
+ *
+ * @var merge_out::flush
+ * (Optional) Called with buf and the number of elements in it each time it
+ * fills and once more with whatever is left at the end. It may return non-zero
+ * (e.g., an errno value) to abort the merge, which then returns that value.
+ *
+ * @var merge_out::context
+ * Passed to flush.
+ */
+struct merge_out {
+    void *buf;
+    size_t n;
+    int (*flush)(const void *block, size_t n, void *context);
+    void *context;
+};
+
+#if GCC_VERSION < 40700
+
+/* fallback comparison through whichever function def has */
+static int
+_merge_less(const struct qsort_def *def, const void *a, const void *b,
+            void *arg) {
+    if (!!def->less_r)
+        return def->less_r(a, b, arg);
+    if (!!def->less)
+        return def->less(a, b);
+    if (!!def->compar_r)
+        return def->compar_r(a, b, arg) < 0;
+    return def->compar(a, b) < 0;
+}
+
+/* fallback output of one element to out, of which *used are filled */
+static int
+_merge_put(const struct qsort_def *def, const struct merge_out *out,
+           size_t *used, const void *elem) {
+    char *const dest = (char *)out->buf + *used * def->size;
+    int ret;
+
+    if (!!def->elem_copy)
+        def->elem_copy(dest, elem);
+    else
+        memcpy(dest, elem, def->size);
+
+    if (++*used < out->n || !out->flush)
+        return 0;
+
+    ret = out->flush(out->buf, *used, out->context);
+    *used = 0;
+
+    return ret;
+}
+
+/* fallback merge_k_template function -- finds each next element by scanning
+ * the heads of all runs */
+static int
+merge_k_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 const struct merge_run *runs, size_t k,
+                 const struct merge_out *out, void *arg) {
+    size_t *pos = calloc(k ? k : 1, sizeof(size_t));
+    size_t total = 0;
+    size_t used = 0;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < k; ++i)
+        total += runs[i].n;
+
+    if (out->flush ? !out->n : out->n < total)
+        ret = EINVAL;
+    else if (!pos)
+        ret = ENOMEM;
+
+    while (!ret && total--) {
+        const char *best = NULL;
+        size_t w = 0;
+
+        /* ties go to the earlier run */
+        for (i = 0; i < k; ++i) {
+            const char *head = (const char *)runs[i].base + pos[i] * def->size;
+
+            if (pos[i] < runs[i].n
+                    && (!best || _merge_less(def, head, best, arg))) {
+                best = head;
+                w = i;
+            }
+        }
+
+        ++pos[w];
+        ret = _merge_put(def, out, &used, best);
+    }
+
+    if (!ret && used && out->flush)
+        ret = out->flush(out->buf, used, out->context);
+
+    free(pos);
+
+    return ret;
+}
+
+/* fallback merge_template function */
+static int
+merge_template(const struct qsort_def *def, const void *a, size_t na,
+               const void *b, size_t nb, const struct merge_out *out,
+               void *arg) {
+    const struct merge_run runs[2] = {{a, na}, {b, nb}};
+
+    return merge_k_template(def, NULL, 0, runs, 2, out, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/* An output block being filled. */
+struct _merge_block {
+    const struct merge_out *out;
+    char *cur;
+    char *end;
+};
+
+/**
+ * @brief Validate a def for the merge functions and fill in its defaults.
+ */
+static gboing_always_inline void
+_merge_init_def(struct qsort_def *d) {
+    _qsort_init_def(d);
+
+    gboing_assert_const(!d->less + !d->compar + !d->less_r + !d->compar_r);
+    gboing_assert_const(d->align);
+    gboing_assert_const(d->size);
+    gboing_assert_msg(!!d->less || !!d->compar || !!d->less_r || !!d->compar_r,
+                      "a less or compar function is required");
+    gboing_assert_msg(!d->aligned_alloc || !!d->free,
+                      "aligned_alloc requires a free function");
+}
+
+/**
+ * @brief Set up the output block for a merge of total elements.
+ *
+ * @return zero or EINVAL if out can't take them.
+ */
+static gboing_always_inline int
+_merge_block_init(const struct qsort_def *def, struct _merge_block *blk,
+                  const struct merge_out *out, size_t total) {
+    gboing_assert_early(!((uintptr_t)out->buf & (def->align - 1)));
+
+    if (out->flush ? !out->n : out->n < total)
+        return EINVAL;
+
+    blk->out = out;
+    blk->cur = (char *)out->buf;
+    blk->end = blk->cur + out->n * def->size;
+
+    return 0;
+}
+
+/**
+ * @brief Hand the output block to the flush function, if there's one and
+ *        there's anything in it.
+ */
+static gboing_always_inline int
+_merge_flush(const struct qsort_def *def, struct _merge_block *blk) {
+    const struct merge_out *out = blk->out;
+    char *const buf = (char *)out->buf;
+    int ret;
+
+    if (!out->flush || blk->cur == buf)
+        return 0;
+
+    ret = out->flush(buf, (size_t)(blk->cur - buf) / def->size, out->context);
+    blk->cur = buf;
+
+    return ret;
+}
+
+/**
+ * @brief Output one element.
+ */
+static gboing_always_inline int
+_merge_put(const struct qsort_def *def, struct _merge_block *blk,
+           const void *elem) {
+    _qsort_copy(def, blk->cur, elem);
+    blk->cur += def->size;
+
+    return blk->cur == blk->end ? _merge_flush(def, blk) : 0;
+}
+
+/**
+ * @brief Output n consecutive elements, a block at a time.
+ */
+static gboing_always_inline int
+_merge_put_n(const struct qsort_def *def, struct _merge_block *blk,
+             const char *src, size_t n) {
+    while (n) {
+        const size_t count = gboing_min(n, (size_t)(blk->end - blk->cur)
+                                           / def->size);
+        int ret;
+
+        _qsort_copy_n(def, blk->cur, src, count);
+        blk->cur += count * def->size;
+        src += count * def->size;
+        n -= count;
+
+        if (blk->cur == blk->end && (ret = _merge_flush(def, blk)))
+            return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @breif Stable two-way merge specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. qsort_def::size, qsort_def::align, the less or
+ * compar function and qsort_def::elem_copy are used.
+ *
+ * @param a
+ * First sorted array. Of equal elements, those from a are output first.
+ *
+ * @param na
+ * Number of elements in a.
+ *
+ * @param b
+ * Second sorted array.
+ *
+ * @param nb
+ * Number of elements in b.
+ *
+ * @param out
+ * Where to put the result.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, EINVAL if out is too small or the value returned by
+ *         merge_out::flush if it was non-zero.
+ */
+static gboing_always_inline gboing_flatten int
+merge_template(const struct qsort_def *def, const void *a, size_t na,
+               const void *b, size_t nb, const struct merge_out *out,
+               void *arg) {
+    struct qsort_def d = *def;
+    const char *l = (const char *)a;
+    const char *r = (const char *)b;
+    const char *const l_end = l + na * def->size;
+    const char *const r_end = r + nb * def->size;
+    struct _merge_block blk;
+    int ret;
+
+    _merge_init_def(&d);
+    gboing_assert_early(!((uintptr_t)a & (d.align - 1)));
+    gboing_assert_early(!((uintptr_t)b & (d.align - 1)));
+
+    ret = _merge_block_init(&d, &blk, out, na + nb);
+    if (ret)
+        return ret;
+
+    while (l < l_end && r < r_end) {
+        /* take from b only when strictly less to keep it stable */
+        if (_qsort_less(&d, (void *)r, (void *)l, arg)) {
+            ret = _merge_put(&d, &blk, r);
+            r += d.size;
+        } else {
+            ret = _merge_put(&d, &blk, l);
+            l += d.size;
+        }
+
+        if (ret)
+            return ret;
+    }
+
+    ret = _merge_put_n(&d, &blk, l, (size_t)(l_end - l) / d.size);
+    if (!ret)
+        ret = _merge_put_n(&d, &blk, r, (size_t)(r_end - r) / d.size);
+    if (!ret)
+        ret = _merge_flush(&d, &blk);
+
+    return ret;
+}
+
+/**
+ * @brief Determine if the head of run a is to be output before that of run b.
+ *
+ * Exhausted runs lose to everything and ties go to the earlier run. Which of
+ * the two is earlier is as good as random, so rather than branch on it to
+ * pick which comparison to make, the arguments of one are swapped.
+ *
+ * @return exactly 1 or 0 (relying on _qsort_less() to return the same), as the
+ *         result is negated into a mask.
+ */
+static gboing_always_inline size_t
+_merge_beats(const struct qsort_def *def, const char *const *cur,
+             const char *const *lim, size_t a, size_t b, void *arg) {
+    const size_t a_first = a < b;
+    uintptr_t x;
+    uintptr_t y;
+    uintptr_t diff;
+
+    if (cur[a] == lim[a])
+        return 0;
+
+    if (cur[b] == lim[b])
+        return 1;
+
+    /* a_first ? !less(b, a) : less(a, b), swapping with a mask as gcc turns
+     * ?: back into a branch */
+    x = (uintptr_t)cur[a];
+    y = (uintptr_t)cur[b];
+    diff = (x ^ y) & -(uintptr_t)a_first;
+    x ^= diff;
+    y ^= diff;
+
+    return a_first ^ _qsort_less(def, (void *)x, (void *)y, arg);
+}
+
+/**
+ * @breif Stable k-way merge specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters (see merge_template()). qsort_def::max_stack,
+ * qsort_def::aligned_alloc and qsort_def::free are used for the workspace.
+ *
+ * @param buffer
+ * (Optional) Temporary memory to use for the loser tree instead of allocating
+ * it on the stack or heap. It needs k * (2 * sizeof(void *) + 3 *
+ * sizeof(size_t)) bytes, aligned to __alignof__(void *).
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param runs
+ * The sorted arrays. Of equal elements, those from earlier runs are output
+ * first.
+ *
+ * @param k
+ * Number of runs.
+ *
+ * @param out
+ * Where to put the result.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, ENOMEM if workspace could not be allocated, EINVAL
+ *         if out is too small or the value returned by merge_out::flush if it
+ *         was non-zero.
+ */
+static gboing_always_inline gboing_flatten int
+merge_k_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 const struct merge_run *runs, size_t k,
+                 const struct merge_out *out, void *arg) {
+    struct qsort_def d = *def;
+    const size_t ws_size = k * (2 * sizeof(char *) + 3 * sizeof(size_t));
+    struct _qsort_ws ws;
+    size_t mem_tmp_offset = 0;
+    void *mem;
+    const char **cur;
+    const char **lim;
+    size_t *tree;
+    size_t *win;
+    size_t total = 0;
+    size_t i;
+    struct _merge_block blk;
+    int ret;
+
+    _merge_init_def(&d);
+
+    for (i = 0; i < k; ++i) {
+        gboing_assert_early(!((uintptr_t)runs[i].base & (d.align - 1)));
+        total += runs[i].n;
+    }
+
+    ret = _merge_block_init(&d, &blk, out, total);
+    if (ret || !k)
+        return ret;
+
+    /* ==== workspace ==== -- supplied buffer, stack, then heap */
+    _qsort_ws_init(&ws, buffer, buf_size, d.max_stack);
+    mem = _qsort_ws_place_stack(&ws, ws_size, gboing_alignof(void *),
+                                &mem_tmp_offset);
+
+    if (_qsort_ws_alloc(&ws, d.aligned_alloc))
+        return ENOMEM;
+
+    if (!mem)
+        mem = _qsort_ws_heap(&ws, mem_tmp_offset);
+
+    cur = (const char **)mem;
+    lim = cur + k;
+    tree = (size_t *)(lim + k);
+    win = tree + k;                 /* winners while building, 2k entries */
+
+    for (i = 0; i < k; ++i) {
+        cur[i] = (const char *)runs[i].base;
+        lim[i] = cur[i] + runs[i].n * d.size;
+        win[k + i] = i;
+    }
+
+    /* tree[node] holds the loser of the match at node and tree[0] the
+     * overall winner; the leaf of run i is node k + i */
+    for (i = k; --i;) {
+        const size_t a = win[2 * i];
+        const size_t b = win[2 * i + 1];
+
+        if (_merge_beats(&d, cur, lim, a, b, arg)) {
+            win[i] = a;
+            tree[i] = b;
+        } else {
+            win[i] = b;
+            tree[i] = a;
+        }
+    }
+    tree[0] = win[1];
+
+    for (;;) {
+        size_t w = tree[0];
+        size_t node;
+
+        /* when the winner is exhausted, so are the rest */
+        if (cur[w] == lim[w])
+            break;
+
+        ret = _merge_put(&d, &blk, cur[w]);
+        if (ret)
+            goto out;
+
+        cur[w] += d.size;
+
+        /* replay the matches on the path from w's leaf to the root, keeping
+         * the winner and loser of each with masks too, as the outcome is
+         * unpredictable */
+        for (node = (k + w) / 2; node; node /= 2) {
+            const size_t t = tree[node];
+            const size_t swap = -_merge_beats(&d, cur, lim, t, w, arg);
+
+            tree[node] = (w & swap) | (t & ~swap);
+            w = (t & swap) | (w & ~swap);
+        }
+        tree[0] = w;
+    }
+
+    ret = _merge_flush(&d, &blk);
+
+out:
+    _qsort_ws_free(&ws, d.free);
+
+    return ret;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _MERGE_TEMPLATE_H_ */
@@ -0,0 +1,301 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif A stable merge sort C metafunction
+ *
+ * glibc's msort recurses, which is a barrier across which gcc cannot fold
+ * constants, so it cannot be made into a metafunction as is. This is instead a
+ * bottom-up (iterative) merge sort: runs of qsort_def::max_thresh elements are
+ * first ordered with insertion sort and then merged in passes of doubling
+ * width, alternating between the array and a workspace of n elements. It is
+ * specialized with the same struct qsort_def as qsort_template() and, like it,
+ * sorts an index of pointers instead of the elements themselves when they are
+ * large (see _qsort_is_indirect()).
+ */
+
+#ifndef _MSORT_TEMPLATE_H_
+#define _MSORT_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback msort_template function */
+static int
+msort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+               void *const pbase, size_t n, void *arg) {
+    assert(!!def->compar || !!def->compar_r);
+
+    if (!!def->compar_r)
+        qsort_r(pbase, n, def->size, def->compar_r, arg);
+    else
+        qsort(pbase, n, def->size, def->compar);
+
+    return 0;
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @brief Stable insertion sort of n elements at lo.
+ */
+static gboing_always_inline gboing_flatten void
+_msort_insertion(const struct qsort_def *def, char *lo, size_t n, void *arg) {
+    const size_t size = def->size;
+    char *const end = lo + n * size;
+    char *run_ptr;
+
+    for (run_ptr = lo + size; run_ptr < end; run_ptr += size) {
+        char *tmp_ptr = run_ptr;
+
+        while (tmp_ptr > lo && _qsort_less(def, run_ptr, tmp_ptr - size, arg))
+            tmp_ptr -= size;
+
+        if (tmp_ptr != run_ptr)
+            _qsort_ror(def, tmp_ptr, run_ptr);
+    }
+}
+
+/**
+ * @brief Stable merge of the adjacent runs l (nl elements) and r (nr elements)
+ *        into dest.
+ *
+ * When the runs are already in order (common with partially sorted input),
+ * they are copied with a single memcpy.
+ */
+static gboing_always_inline gboing_flatten void
+_msort_merge(const struct qsort_def *def, char *dest, char *l, size_t nl,
+             char *r, size_t nr, void *arg) {
+    const size_t size = def->size;
+    char *const l_end = l + nl * size;
+    char *const r_end = r + nr * size;
+
+    assert(l_end == r);
+
+    if (!nr || !_qsort_less(def, r, l_end - size, arg)) {
+        _qsort_copy_n(def, dest, l, nl + nr);
+        return;
+    }
+
+    while (l < l_end && r < r_end) {
+        /* take from the right only when strictly less to keep it stable */
+        if (_qsort_less(def, r, l, arg)) {
+            _qsort_copy(def, dest, r);
+            r += size;
+        } else {
+            _qsort_copy(def, dest, l);
+            l += size;
+        }
+        dest += size;
+    }
+
+    if (l < l_end)
+        _qsort_copy_n(def, dest, l, (size_t)(l_end - l) / size);
+    else if (r < r_end)
+        _qsort_copy_n(def, dest, r, (size_t)(r_end - r) / size);
+}
+
+/**
+ * @breif Stable merge sort specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored
+ * except qsort_def::max_size_bits (which only sizes qsort_template()'s stack),
+ * qsort_def::introsort, qsort_def::key_prefix (an index, when used, holds only
+ * pointers) and qsort_def::adaptive (no runs are looked for before sorting).
+ * qsort_def::max_thresh is the length of the runs ordered with insertion sort
+ * before merging.
+ *
+ * @param buffer
+ * (Optional) Temporary memory to use instead of allocating memory on the stack
+ * and/or heap. If supplied, it should be aligned to the greater of
+ * qsort_def::align or the __alignof__(void *). The merge workspace needs n
+ * elements (or n pointers when indirect sorting is used), so for it to be
+ * used, the buffer must be large enough to hold it.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, ENOMEM if workspace could not be allocated or
+ *         EINVAL if qsort_def::elem_buf can't hold an index entry.
+ */
+static gboing_always_inline gboing_flatten int
+msort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+               void *const pbase, size_t n, void *arg) {
+    /* this copy of def will be mutated to manage indirect sorting if needed */
+    struct qsort_def d = *def;
+    const size_t PTR_ALIGN          = gboing_alignof(void *);
+    const int indirect              = _qsort_is_indirect(&d); /* ct const */
+    const size_t ELEM_BUF_SIZE      = _qsort_elem_buf_size(&d);
+    const size_t ELEM_BUF_ALIGN     = _qsort_elem_buf_align(&d);
+    struct _qsort_ws ws;
+    size_t elem_buf_tmp_offset      = 0;
+    size_t index_tmp_offset         = 0;
+    size_t work_tmp_offset          = 0;
+    char *work;
+    char *base;
+    char *src;
+    char *dest;
+    size_t run;
+    size_t width;
+    size_t i;
+
+    if (n < 2)
+        return 0;
+
+    /* Restrict to reasonable value */
+    if (d.align > _QSORT_ALIGN_MAX)
+        d.align = _QSORT_ALIGN_MAX;
+
+    if (!d.max_thresh)
+        d.max_thresh = DEFAULT_MAX_THRESH;
+
+    if (!d.max_stack)
+        d.max_stack = 1024;
+
+    d.index = NULL; /* ignore if it was populated by caller */
+
+    /* validate required fields are constants */
+    gboing_assert_const(!d.less + !d.compar + !d.less_r + !d.compar_r);
+    gboing_assert_const(d.align);
+    gboing_assert_const(d.size);
+    gboing_assert_const(d.max_thresh);
+    gboing_assert_msg(!!d.less || !!d.compar || !!d.less_r || !!d.compar_r,
+                      "a less or compar function is required");
+    gboing_assert_msg(!(d.align & (d.align - 1)),
+                      "align must be a power of two");
+    gboing_assert_msg(!(d.size % d.align),
+                      "size must be a multiple of align");
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+
+    /* verify pbase and buffer are really aligned as advertised */
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+    gboing_assert_early(buffer || !buf_size);
+    gboing_assert_early(((uintptr_t)buffer
+                        % gboing_max(d.align, PTR_ALIGN)) == 0);
+
+    _qsort_ws_init(&ws, buffer, buf_size, d.max_stack);
+
+    /* ==== d.elem_buf ==== -- buffer, then stack, then heap */
+    if (!d.elem_buf)
+        d.elem_buf = _qsort_ws_place_stack(&ws, ELEM_BUF_SIZE, ELEM_BUF_ALIGN,
+                                           &elem_buf_tmp_offset);
+
+    /* a caller's elem_buf only promises qsort_def::size bytes */
+    else if (ELEM_BUF_SIZE > d.size
+             || ((uintptr_t)d.elem_buf & (ELEM_BUF_ALIGN - 1)))
+        return EINVAL;
+
+    /* ==== indirection buffer ==== -- never goes on stack */
+    if (indirect)
+        d.index = _qsort_ws_place(&ws, sizeof(void *) * n, PTR_ALIGN,
+                                  &index_tmp_offset);
+
+    /* ==== merge workspace ==== -- never goes on stack */
+    work = indirect
+         ? _qsort_ws_place(&ws, sizeof(void *) * n, PTR_ALIGN,
+                           &work_tmp_offset)
+         : _qsort_ws_place(&ws, d.size * n, d.align, &work_tmp_offset);
+
+    /* allocate if heap space needed */
+    if (_qsort_ws_alloc(&ws, d.aligned_alloc))
+        return ENOMEM;
+
+    if (!d.elem_buf)
+        d.elem_buf = _qsort_ws_heap(&ws, elem_buf_tmp_offset);
+
+    if (indirect && !d.index)
+        d.index = _qsort_ws_heap(&ws, index_tmp_offset);
+
+    if (!work)
+        work = _qsort_ws_heap(&ws, work_tmp_offset);
+
+    d.elem_buf = gboing_assume_aligned(d.elem_buf, ELEM_BUF_ALIGN);
+    assert(!((uintptr_t)d.elem_buf % ELEM_BUF_ALIGN));
+
+    /* if using indirection, sort pointers to the elements instead */
+    if (indirect) {
+        d.size = sizeof(void *);
+        d.align = PTR_ALIGN;
+
+        for (i = n; i--;)
+            d.index[i] = (char *)pbase + i * def->size;
+
+        base = (char *)d.index;
+    } else
+        base = (char *)pbase;
+
+    gboing_assert_const(indirect);
+
+    /* ==== Insertion sort each run ==== */
+    run = d.max_thresh;
+    for (i = 0; i < n; i += run)
+        _msort_insertion(&d, base + i * d.size, gboing_min(run, n - i), arg);
+
+    /* ==== Merge runs of doubling width ==== */
+    src = base;
+    dest = work;
+    for (width = run; width < n; width *= 2) {
+        char *tmp;
+
+        for (i = 0; i < n; i += 2 * width) {
+            const size_t mid = gboing_min(i + width, n);
+            const size_t hi  = gboing_min(i + 2 * width, n);
+
+            _msort_merge(&d, dest + i * d.size, src + i * d.size, mid - i,
+                         src + mid * d.size, hi - mid, arg);
+        }
+
+        tmp = src;
+        src = dest;
+        dest = tmp;
+    }
+
+    if (src != base)
+        _qsort_copy_n(&d, base, src, n);
+
+    /* if we used indirect sorting, now we have to re-arrange the array. */
+    if (indirect) {
+        void **index = d.index;
+
+        d.size  = def->size;
+        d.align = def->align;
+        d.index = NULL;
+
+        _qsort_apply_index(&d, pbase, index, n);
+    }
+
+    _qsort_ws_free(&ws, d.free);
+
+    return 0;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _MSORT_TEMPLATE_H_ */
@@ -0,0 +1,236 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Quickselect and partial sort C metafunctions
+ *
+ * qselect_template() is Hoare's quickselect (C++'s nth_element): it partitions
+ * exactly as qsort_template() does, but only continues into the side holding
+ * the element sought, so it runs in O(n) expected time. Like introsort, it
+ * tracks its depth and, past 2 * log2(n) partitions, heapsorts what's left,
+ * bounding the worst case to O(n log n) (introselect, as in libstdc++).
+ *
+ * partial_sort_template() selects the k smallest elements and then sorts only
+ * those with qsort_template(), in O(n + k log k).
+ */
+
+#ifndef _QSELECT_TEMPLATE_H_
+#define _QSELECT_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback qselect_template function -- selection by sorting */
+static int
+qselect_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 void *const pbase, size_t n, size_t k, void *arg) {
+    return qsort_template(def, pbase, n, arg);
+}
+
+/* fallback partial_sort_template function */
+static int
+partial_sort_template(const struct qsort_def *def, void *buffer,
+                      size_t buf_size, void *const pbase, size_t n, size_t k,
+                      void *arg) {
+    return qsort_template(def, pbase, n, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @breif Quickselect specialized by a struct qsort_def.
+ *
+ * On return, the element at index k is the one that would be there if the
+ * array were sorted, no element before it is greater and no element after it
+ * is less.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored,
+ * except that elements are never sorted indirectly: selection only moves each
+ * element a constant number of times on average.
+ *
+ * @param buffer
+ * (Optional) Temporary memory to hold the element buffer instead of allocating
+ * it on the stack or heap. If supplied, it should be aligned to
+ * qsort_def::align. If not used, a compile-time constant NULL value should be
+ * passed to reduce generated code.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param k
+ * Index of the element to select. Nothing is done if k >= n.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success or ENOMEM if an element buffer could not be
+ *         allocated.
+ */
+static gboing_always_inline gboing_flatten int
+qselect_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                 void *const pbase, size_t n, size_t k, void *arg) {
+    struct qsort_def d = *def;
+    char *const base_ptr = (char *)pbase;
+    char *const target = base_ptr + k * d.size;
+    char *lo = base_ptr;
+    char *hi = base_ptr + (n - 1) * d.size;
+    void *tmp_buffer = NULL;
+    size_t max_thresh;
+    size_t depth;
+
+    if (k >= n)
+        return 0;
+
+    _qsort_init_def(&d);
+
+    max_thresh = d.max_thresh * d.size;
+
+    gboing_assert_const(!d.less + !d.compar + !d.less_r + !d.compar_r);
+    gboing_assert_const(d.align);
+    gboing_assert_const(d.size);
+    gboing_assert_const(max_thresh);
+    gboing_assert_const(d.block_size);
+    gboing_assert_const(d.key_kind);
+    gboing_assert_msg(!!d.less || !!d.compar || !!d.less_r || !!d.compar_r,
+                      "a less or compar function is required");
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+    gboing_assert_early(buffer || !buf_size);
+    gboing_assert_early(!((uintptr_t)buffer & (d.align - 1)));
+
+    /* ==== d.elem_buf ==== -- supplied buffer, stack, then heap */
+    if (!d.elem_buf) {
+        if (buf_size >= d.size)
+            d.elem_buf = buffer;
+        else if (d.size < d.max_stack)
+            d.elem_buf = gboing_aligned_alloca(d.align, d.size);
+        else {
+            if (!!d.aligned_alloc)
+                tmp_buffer = d.aligned_alloc(d.align, d.size);
+            else
+                tmp_buffer = gboing_aligned_alloc(d.align, d.size);
+
+            if (!tmp_buffer)
+                return ENOMEM;
+
+            d.elem_buf = tmp_buffer;
+        }
+    }
+
+    d.elem_buf = gboing_assume_aligned(d.elem_buf, d.align);
+
+    for (depth = 2 * _qsort_log2(n); (size_t)(hi - lo) > max_thresh; --depth) {
+        char *left_ptr;
+        char *right_ptr;
+
+        if (!depth) {
+            _qsort_heapsort(&d, lo, hi, arg);
+            lo = hi;
+            break;
+        }
+
+        _qsort_partition(&d, base_ptr, lo, hi, &left_ptr, &right_ptr, arg);
+
+        /* only the side holding target needs any more work */
+        if (target <= right_ptr)
+            hi = right_ptr;
+        else if (target >= left_ptr)
+            lo = left_ptr;
+        else
+            break;
+    }
+
+    if (lo < hi && (size_t)(hi - lo) <= max_thresh) {
+        if (_qsort_net_lanes(&d))
+            _qsort_net_sort(&d, lo, hi);
+        else
+            _qsort_insertion_sort(&d, lo, (size_t)(hi - lo) / d.size + 1, arg);
+    }
+
+    if (tmp_buffer) {
+        if (d.free)
+            d.free(tmp_buffer);
+        else
+            gboing_aligned_free(tmp_buffer);
+    }
+
+    return 0;
+}
+
+/**
+ * @breif Partial sort specialized by a struct qsort_def.
+ *
+ * On return, the first k elements are the k smallest in sorted order and the
+ * remainder are in no particular order.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored.
+ *
+ * @param buffer
+ * (Optional) Temporary memory for qsort_template() to use.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param k
+ * Number of elements to sort. The whole array is sorted if k >= n.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+partial_sort_template(const struct qsort_def *def, void *buffer,
+                      size_t buf_size, void *const pbase, size_t n, size_t k,
+                      void *arg) {
+    int ret;
+
+    if (k >= n)
+        return qsort_template(def, buffer, buf_size, pbase, n, arg);
+
+    if (!k)
+        return 0;
+
+    /* the kth smallest goes to k - 1 with everything less before it */
+    ret = qselect_template(def, buffer, buf_size, pbase, n, k - 1, arg);
+    if (ret)
+        return ret;
+
+    return qsort_template(def, buffer, buf_size, pbase, k - 1, arg);
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _QSELECT_TEMPLATE_H_ */
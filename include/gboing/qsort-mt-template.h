@@ -0,0 +1,496 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif A multithreaded qsort C metafunction
+ *
+ * qsort_template_mt() partitions the array with a pool of pthreads. Each
+ * worker keeps a deque of partitions: after each partition step it pushes the
+ * larger side onto the bottom of its own deque and continues with the smaller
+ * side, so that idle workers can steal the largest outstanding partitions from
+ * the top of the others' deques. Once a partition is no larger than the
+ * cutoff, the worker sorts it serially exactly as qsort_template() would, using
+ * its own element buffer and stack. A worker with nothing to take sleeps on
+ * the pool's condition variable until a partition is pushed or the sort is
+ * finished.
+ *
+ * A thread's start routine can't be specialized by the struct qsort_def at the
+ * call site, so the caller must instantiate one by wrapping
+ * qsort_mt_worker_template() and pass it in:
+ *
+ * @code
+ * static void *my_worker(void *worker) {
+ *     return qsort_mt_worker_template(&my_def, worker);
+ * }
+ *
+ * ret = qsort_template_mt(&my_def, my_worker, 0, 0, p, n, NULL);
+ * @endcode
+ */
+
+#ifndef _QSORT_MT_TEMPLATE_H_
+#define _QSORT_MT_TEMPLATE_H_
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <gboing/qsort-template.h>
+
+/* Partitions of no more than this many elements are sorted serially. */
+#ifndef QSORT_MT_DEFAULT_CUTOFF
+# define QSORT_MT_DEFAULT_CUTOFF 0x4000
+#endif
+
+#if GCC_VERSION < 40700
+
+/* fallback qsort_mt_worker_template function */
+static void *
+qsort_mt_worker_template(const struct qsort_def *def, void *worker) {
+    return NULL;
+}
+
+/* fallback qsort_template_mt function */
+static int
+qsort_template_mt(const struct qsort_def *def, void *(*worker)(void *),
+                  unsigned nthreads, size_t cutoff, void *const pbase,
+                  size_t n, void *arg) {
+    return qsort_template(def, pbase, n, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+struct qsort_mt_pool;
+
+/* Per-thread state. Aligned to keep workers off each other's cache lines. */
+struct _qsort_mt_worker {
+    pthread_mutex_t lock;           /* protects deque & head; count is only
+                                     * written under it, but atomically */
+    _qsort_depth_node *deque;       /* ring of partitions still to sort */
+    size_t head;                    /* oldest (largest) partition */
+    size_t count;                   /* number of partitions in deque; may be
+                                     * peeked at atomically without lock */
+    stack_node *qstack;             /* stack for _qsort_core() */
+    void *elem_buf;
+    struct qsort_mt_pool *pool;
+    pthread_t thread;
+} gboing_aligned(64);
+
+struct qsort_mt_pool {
+    struct _qsort_mt_worker *workers;
+    unsigned nworkers;
+    size_t capacity;                /* of each deque */
+    size_t cutoff;                  /* in elements */
+    size_t depth_limit;             /* introsort depth limit */
+    char *base;                     /* array (or index) being sorted */
+    void **index;                   /* index when sorting indirectly */
+    size_t pending;                 /* partitions not yet sorted (atomic) */
+    pthread_mutex_t idle_lock;      /* protects idle */
+    pthread_cond_t idle_cond;       /* signalled on push and when done */
+    unsigned idle;                  /* number of workers waiting */
+    void *arg;
+};
+
+/**
+ * @brief Wake a waiting worker, or all of them when the sort is finished.
+ */
+static gboing_always_inline void
+_qsort_mt_wake(struct qsort_mt_pool *pool, int all) {
+    pthread_mutex_lock(&pool->idle_lock);
+    if (pool->idle) {
+        if (all)
+            pthread_cond_broadcast(&pool->idle_cond);
+        else
+            pthread_cond_signal(&pool->idle_cond);
+    }
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+/**
+ * @brief Push a partition onto the bottom of a worker's deque.
+ */
+static gboing_always_inline void
+_qsort_mt_push(struct _qsort_mt_worker *w, char *lo, char *hi, size_t depth) {
+    const size_t capacity = w->pool->capacity;
+    _qsort_depth_node *node;
+
+    __atomic_add_fetch(&w->pool->pending, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&w->lock);
+    assert(w->count < capacity);
+    node = &w->deque[(w->head + w->count) % capacity];
+    node->lo = lo;
+    node->hi = hi;
+    node->depth = depth;
+    __atomic_add_fetch(&w->count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&w->lock);
+
+    _qsort_mt_wake(w->pool, 0);
+}
+
+/**
+ * @brief Take a partition from the bottom of self's deque or, failing that,
+ *        steal one from the top of another worker's.
+ *
+ * @return non-zero if a partition was stored in node.
+ */
+static gboing_always_inline int
+_qsort_mt_take(struct qsort_mt_pool *pool, struct _qsort_mt_worker *self,
+               _qsort_depth_node *node) {
+    const size_t capacity = pool->capacity;
+    const unsigned me = self - pool->workers;
+    unsigned i;
+
+    pthread_mutex_lock(&self->lock);
+    if (self->count) {
+        size_t count = __atomic_sub_fetch(&self->count, 1, __ATOMIC_RELAXED);
+
+        *node = self->deque[(self->head + count) % capacity];
+        pthread_mutex_unlock(&self->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 1; i < pool->nworkers; ++i) {
+        struct _qsort_mt_worker *victim = &pool->workers[(me + i)
+                                                         % pool->nworkers];
+
+        /* peek without the lock first to avoid contending for empty deques */
+        if (!__atomic_load_n(&victim->count, __ATOMIC_RELAXED))
+            continue;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->count) {
+            *node = victim->deque[victim->head];
+            victim->head = (victim->head + 1) % capacity;
+            __atomic_sub_fetch(&victim->count, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&victim->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wait until a partition is queued or none are pending.
+ *
+ * Both are checked under idle_lock, which pushes and the final decrement of
+ * pending also take before waking anyone, so a wake-up can't be missed.
+ *
+ * @return non-zero if the sort is finished.
+ */
+static gboing_always_inline int
+_qsort_mt_wait(struct qsort_mt_pool *pool) {
+    int done;
+
+    pthread_mutex_lock(&pool->idle_lock);
+    for (;;) {
+        unsigned i;
+
+        done = !__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE);
+        if (done)
+            break;
+
+        for (i = 0; i < pool->nworkers; ++i)
+            if (__atomic_load_n(&pool->workers[i].count, __ATOMIC_RELAXED))
+                break;
+
+        if (i < pool->nworkers)
+            break;
+
+        ++pool->idle;
+        pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        --pool->idle;
+    }
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    return done;
+}
+
+/**
+ * @brief Body of a qsort_template_mt() worker thread specialized by a struct
+ *        qsort_def.
+ *
+ * @param def
+ * The template parameters, which must be the same as those passed to
+ * qsort_template_mt().
+ *
+ * @param worker
+ * The start routine's argument.
+ *
+ * @return NULL
+ */
+static gboing_always_inline gboing_flatten void *
+qsort_mt_worker_template(const struct qsort_def *def, void *worker) {
+    struct _qsort_mt_worker *self = worker;
+    struct qsort_mt_pool *pool = self->pool;
+    struct qsort_def d = *def;
+    const int indirect = _qsort_is_indirect(&d); /* ct const */
+    size_t cutoff;
+
+    _qsort_init_def(&d);
+    d.elem_buf = gboing_assume_aligned(self->elem_buf,
+                                       _qsort_elem_buf_align(&d));
+
+    if (indirect) {
+        d.size  = sizeof(void *);
+        d.align = gboing_alignof(void *);
+        d.index = pool->index;
+    }
+
+    cutoff = pool->cutoff * d.size;
+
+    gboing_assert_const(indirect);
+    gboing_assert_const(d.size);
+
+    for (;;) {
+        _qsort_depth_node node;
+        char *lo;
+        char *hi;
+        size_t depth;
+
+        if (!_qsort_mt_take(pool, self, &node)) {
+            if (_qsort_mt_wait(pool))
+                break;
+
+            continue;
+        }
+
+        lo = node.lo;
+        hi = node.hi;
+        depth = node.depth;
+
+        /* Hand the larger side of each partition to the pool until what's
+           left is small enough to sort serially (or we're in too deep, in
+           which case _qsort_core()'s own introsort takes over). */
+        while ((size_t)(hi - lo) > cutoff && depth <= pool->depth_limit) {
+            char *left_ptr;
+            char *right_ptr;
+
+            _qsort_partition(&d, pool->base, lo, hi, &left_ptr, &right_ptr,
+                             pool->arg);
+            ++depth;
+
+            if ((right_ptr - lo) > (hi - left_ptr)) {
+                _qsort_mt_push(self, lo, right_ptr, depth);
+                lo = left_ptr;
+            } else {
+                _qsort_mt_push(self, left_ptr, hi, depth);
+                hi = right_ptr;
+            }
+        }
+
+        if (lo < hi)
+            _qsort_core(&d, lo, (size_t)(hi - lo) / d.size + 1, self->qstack,
+                        pool->arg);
+
+        if (!__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELEASE))
+            _qsort_mt_wake(pool, 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * @breif Multithreaded qsort specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored
+ * except qsort_def::key_prefix (an index, when used, holds only pointers) and
+ * qsort_def::adaptive (no runs are looked for before partitioning).
+ *
+ * @param worker
+ * Thread start routine that returns qsort_mt_worker_template(def, arg).
+ *
+ * @param nthreads
+ * Number of threads to sort with, including the calling thread, or zero for
+ * one per online CPU.
+ *
+ * @param cutoff
+ * Partitions of no more than this many elements are sorted serially, or zero
+ * for QSORT_MT_DEFAULT_CUTOFF. Arrays this small are sorted by calling
+ * qsort_template() directly.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+qsort_template_mt(const struct qsort_def *def, void *(*worker)(void *),
+                  unsigned nthreads, size_t cutoff, void *const pbase,
+                  size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const int indirect              = _qsort_is_indirect(&d); /* ct const */
+    const size_t PTR_ALIGN          = gboing_alignof(void *);
+    const size_t WORKER_ALIGN       = gboing_alignof(struct _qsort_mt_worker);
+    struct qsort_mt_pool pool;
+    size_t tmp_align;
+    size_t qstack_size;
+    size_t tmp_needed               = 0;
+    size_t workers_offset;
+    size_t blocks_offset;
+    size_t index_offset             = 0;
+    size_t deque_offset;
+    size_t qstack_offset;
+    size_t elem_buf_offset;
+    size_t worker_size;
+    void *tmp_buffer;
+    unsigned started;
+    unsigned i;
+
+    if (!cutoff)
+        cutoff = QSORT_MT_DEFAULT_CUTOFF;
+
+    if (!nthreads) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+
+    if (nthreads < 2 || n <= cutoff)
+        return qsort_template(def, NULL, 0, pbase, n, arg);
+
+    _qsort_init_def(&d);
+
+    if (cutoff < d.max_thresh)
+        cutoff = d.max_thresh;
+
+    assert(n <= ((size_t)1 << d.max_size_bits) - 1);
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+
+    /* Lay out the workers, then each one's deque, qstack and elem_buf and
+     * finally the index, all in one allocation. A deque never holds more
+     * than one partition per level of nesting. */
+    pool.capacity = d.max_size_bits + 1;
+    qstack_size = _qsort_stack_size(&d);
+
+    workers_offset = _qsort_ws_reserve(&tmp_needed,
+                                       sizeof(struct _qsort_mt_worker)
+                                       * nthreads, WORKER_ALIGN);
+    tmp_align = gboing_max(WORKER_ALIGN, _qsort_elem_buf_align(&d));
+    worker_size = 0;
+    deque_offset = _qsort_ws_reserve(&worker_size,
+                                     sizeof(_qsort_depth_node) * pool.capacity,
+                                     gboing_alignof(_qsort_depth_node));
+    qstack_offset = _qsort_ws_reserve(&worker_size, qstack_size,
+                                      gboing_alignof(stack_node));
+    elem_buf_offset = _qsort_ws_reserve(&worker_size,
+                                        _qsort_elem_buf_size(&d),
+                                        _qsort_elem_buf_align(&d));
+    worker_size = _qsort_ws_reserve(&worker_size, 0, tmp_align);
+    blocks_offset = _qsort_ws_reserve(&tmp_needed, worker_size * nthreads,
+                                      tmp_align);
+
+    if (indirect)
+        index_offset = _qsort_ws_reserve(&tmp_needed, sizeof(void *) * n,
+                                         PTR_ALIGN);
+
+    if (!!d.aligned_alloc)
+        tmp_buffer = d.aligned_alloc(tmp_align, tmp_needed);
+    else
+        tmp_buffer = gboing_aligned_alloc(tmp_align, tmp_needed);
+
+    if (!tmp_buffer)
+        return ENOMEM;
+
+    pool.workers = (struct _qsort_mt_worker *)((char *)tmp_buffer
+                                               + workers_offset);
+    pool.nworkers = nthreads;
+    pool.cutoff = cutoff;
+    pool.depth_limit = d.introsort ? 2 * _qsort_log2(n) : SIZE_MAX;
+    pool.pending = 1;
+    pool.idle = 0;
+    pool.arg = arg;
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle_cond, NULL);
+    pool.index = NULL;
+
+    for (i = 0; i < nthreads; ++i) {
+        struct _qsort_mt_worker *w = &pool.workers[i];
+        char *mem = (char *)tmp_buffer + blocks_offset + worker_size * i;
+
+        pthread_mutex_init(&w->lock, NULL);
+        w->deque    = (_qsort_depth_node *)(mem + deque_offset);
+        w->head     = 0;
+        __atomic_store_n(&w->count, 0, __ATOMIC_RELAXED);
+        w->qstack   = (stack_node *)(mem + qstack_offset);
+        w->elem_buf = mem + elem_buf_offset;
+        w->pool     = &pool;
+    }
+
+    /* if using indirection, sort pointers to the elements instead */
+    if (indirect) {
+        pool.index = (void **)((char *)tmp_buffer + index_offset);
+
+        for (i = 0; i < n; ++i)
+            pool.index[i] = (char *)pbase + (size_t)i * d.size;
+
+        pool.base = (char *)pool.index;
+        pool.workers[0].deque[0].hi = pool.base + sizeof(void *) * (n - 1);
+    } else {
+        pool.base = (char *)pbase;
+        pool.workers[0].deque[0].hi = pool.base + d.size * (n - 1);
+    }
+
+    pool.workers[0].deque[0].lo = pool.base;
+    pool.workers[0].deque[0].depth = 0;
+    __atomic_store_n(&pool.workers[0].count, 1, __ATOMIC_RELAXED);
+
+    /* the calling thread is worker 0; if a thread can't be created, the rest
+     * of the workers simply never take any partitions */
+    for (started = 1; started < nthreads; ++started)
+        if (pthread_create(&pool.workers[started].thread, NULL, worker,
+                           &pool.workers[started]))
+            break;
+
+    worker(&pool.workers[0]);
+
+    for (i = 1; i < started; ++i)
+        pthread_join(pool.workers[i].thread, NULL);
+
+    assert(!pool.pending);
+
+    /* if we used indirect sorting, now we have to re-arrange the array. */
+    if (indirect) {
+        d.elem_buf = pool.workers[0].elem_buf;
+        _qsort_apply_index(&d, pbase, pool.index, n);
+    }
+
+    for (i = 0; i < nthreads; ++i)
+        pthread_mutex_destroy(&pool.workers[i].lock);
+    pthread_cond_destroy(&pool.idle_cond);
+    pthread_mutex_destroy(&pool.idle_lock);
+
+    if (d.free)
+        d.free(tmp_buffer);
+    else
+        gboing_aligned_free(tmp_buffer);
+
+    return 0;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _QSORT_MT_TEMPLATE_H_ */
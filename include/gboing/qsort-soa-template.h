@@ -0,0 +1,211 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Structure-of-arrays sorting C metafunction
+ *
+ * qsort_soa_template() sorts a key array and moves the elements of any number
+ * of parallel payload arrays (columns), each of its own element size, along
+ * with their keys, without gathering them into an array of structures first.
+ *
+ * The keys are always sorted indirectly, by qsort_template() itself, and the
+ * permutation is then applied to the keys and every column in the same pass
+ * (see _qsort_apply_index()), so each element of each column is copied only
+ * once plus once per permutation cycle.
+ */
+
+#ifndef _QSORT_SOA_TEMPLATE_H_
+#define _QSORT_SOA_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback context for comparing keys through an index of pointers */
+struct _soa_ctx {
+    const struct qsort_def *def;
+    void *arg;
+};
+
+/* fallback comparison of the keys two index entries point to */
+static int
+_soa_compar_r(const void *a, const void *b, void *context) {
+    const struct _soa_ctx *ctx = context;
+    const struct qsort_def *def = ctx->def;
+    const void *ka = *(void *const *)a;
+    const void *kb = *(void *const *)b;
+
+    if (!!def->compar_r)
+        return def->compar_r(ka, kb, ctx->arg);
+    if (!!def->compar)
+        return def->compar(ka, kb);
+    if (!!def->less_r)
+        return def->less_r(ka, kb, ctx->arg) ? -1
+                                             : def->less_r(kb, ka, ctx->arg);
+    return def->less(ka, kb) ? -1 : def->less(kb, ka);
+}
+
+/* fallback gather of an array of n elements of size bytes into the order
+ * given by an index of pointers to keys, through tmp */
+static void
+_soa_gather(void (*elem_copy)(void *dest, const void *src), char *base,
+            size_t size, void **index, const char *keys, size_t key_size,
+            size_t n, char *tmp) {
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        const char *src = base + ((const char *)index[i] - keys) / key_size
+                                 * size;
+
+        if (!!elem_copy)
+            elem_copy(&tmp[i * size], src);
+        else
+            memcpy(&tmp[i * size], src, size);
+    }
+
+    if (!elem_copy)
+        memcpy(base, tmp, n * size);
+    else
+        for (i = 0; i < n; ++i)
+            elem_copy(&base[i * size], &tmp[i * size]);
+}
+
+/* fallback qsort_soa_template function */
+static int
+qsort_soa_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                   void *const keys, size_t n,
+                   const struct qsort_column *columns, size_t ncolumns,
+                   void *arg) {
+    struct _soa_ctx ctx = {def, arg};
+    size_t tmp_size = def->size;
+    void **index;
+    char *tmp;
+    size_t i;
+
+    for (i = 0; i < ncolumns; ++i)
+        if (columns[i].size > tmp_size)
+            tmp_size = columns[i].size;
+
+    index = malloc(n * sizeof(void *));
+    tmp = malloc(n * tmp_size);
+    if (!index || !tmp) {
+        free(index);
+        free(tmp);
+        return ENOMEM;
+    }
+
+    for (i = 0; i < n; ++i)
+        index[i] = (char *)keys + i * def->size;
+
+    qsort_r(index, n, sizeof(void *), _soa_compar_r, &ctx);
+
+    _soa_gather(def->elem_copy, keys, def->size, index, keys, def->size, n,
+                tmp);
+    for (i = 0; i < ncolumns; ++i)
+        _soa_gather(NULL, columns[i].base, columns[i].size, index, keys,
+                    def->size, n, tmp);
+
+    free(index);
+    free(tmp);
+    return 0;
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @breif Sort a key array and permute parallel payload arrays to match,
+ *        specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters, describing the keys. All fields used by
+ * qsort_template() are honored, except that the keys are always sorted
+ * indirectly.
+ *
+ * @param buffer
+ * (Optional) Temporary memory for qsort_template() to use.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param keys
+ * Key array.
+ *
+ * @param n
+ * Number of elements in keys and in each column.
+ *
+ * @param columns
+ * The payload arrays. Each must have n elements and none may overlap another
+ * or keys.
+ *
+ * @param ncolumns
+ * Number of columns.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success, ENOMEM if workspace could not be allocated or
+ *         EINVAL if qsort_def::elem_buf is too small to hold an index entry
+ *         (see qsort_def::elem_buf).
+ */
+static gboing_always_inline gboing_flatten int
+qsort_soa_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+                   void *const keys, size_t n,
+                   const struct qsort_column *columns, size_t ncolumns,
+                   void *arg) {
+    struct qsort_def d = *def;
+    struct _qsort_ws ws;
+    size_t column_buf_size = 0;
+    size_t column_buf_tmp_offset = 0;
+    size_t i;
+    int ret;
+
+    _qsort_init_def(&d);
+
+    for (i = 0; i < ncolumns; ++i) {
+        assert(columns[i].size);
+        assert(columns[i].base || !n);
+        column_buf_size += columns[i].size;
+    }
+
+    d._soa = 1;
+    d._columns = columns;
+    d._ncolumns = ncolumns;
+
+    /* ==== column_buf ==== -- stack, then heap; buffer is left to
+     * qsort_template() */
+    _qsort_ws_init(&ws, NULL, 0, d.max_stack);
+    d._column_buf = _qsort_ws_place_stack(&ws, column_buf_size,
+                                          gboing_alignof(void *),
+                                          &column_buf_tmp_offset);
+
+    if (_qsort_ws_alloc(&ws, d.aligned_alloc))
+        return ENOMEM;
+
+    if (!d._column_buf)
+        d._column_buf = _qsort_ws_heap(&ws, column_buf_tmp_offset);
+
+    ret = qsort_template(&d, buffer, buf_size, keys, n, arg);
+
+    _qsort_ws_free(&ws, d.free);
+
+    return ret;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _QSORT_SOA_TEMPLATE_H_ */
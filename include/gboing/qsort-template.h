@@ -31,7 +31,8 @@
  * Note that glibc doesn't normally use stdlib/qsort.c when qsort or qsort_r is
  * called, a more efficient msort algo is used when possible. However, msort
  * cannot be properly converted into a metafunction since it uses recursion --
- * a barrier across which gcc cannot fold constants (at this time).
+ * a barrier across which gcc cannot fold constants (at this time). See
+ * msort-template.h for a non-recursive (bottom-up) stable merge sort.
  */
 
 #ifndef _QSORT_TEMPLATE_H_
@@ -71,11 +72,79 @@
 # define _QSORT_ARCH_MAX_INDEX_MULT __SIZE_MAX__
 #endif
 
-/* Threshold of element size before switching to an indirect sort. */
+/* Width of the vectors that sorting networks (see qsort_def::key_kind) are
+ * built from. Only enabled where a single register can hold at least four
+ * keys and permute them across lanes in one instruction; without that, gcc
+ * lowers the shuffles to scalar code and insertion sort is faster.
+ */
+#if defined(__AVX512F__)
+# define _QSORT_NET_BYTES   64
+# define _QSORT_NET_LANES32 16
+# define _QSORT_NET_LANES64 8
+#elif defined(__AVX2__)
+# define _QSORT_NET_BYTES   32
+# define _QSORT_NET_LANES32 8
+# define _QSORT_NET_LANES64 4
+#endif
+
+/* Width of the vectors used to partition keys (see qsort_def::key_kind). This
+ * needs compress stores (AVX-512) or something to emulate them with (AVX2's
+ * vpermd plus BMI2's pdep and pext to build the permutation).
+ */
+#if defined(__AVX512F__)
+# define _QSORT_VP_BYTES 64
+#elif defined(__AVX2__) && defined(__BMI2__)
+# define _QSORT_VP_BYTES 32
+#endif
+
+#ifdef _QSORT_VP_BYTES
+# include <immintrin.h>
+#endif
+
+/* Largest qsort_def::block_size supported: offsets are stored as bytes. */
+#define _QSORT_MAX_BLOCK_SIZE 128
+
+/* Element size above which insertion sort finds slots by binary search when
+ * elements are sorted directly and compared by compar or compar_r (see
+ * _qsort_binary_insertion()). */
+#ifndef _QSORT_BININS_THRESH
+# define _QSORT_BININS_THRESH 32
+#endif
+
+/* Most slots the branchless insertion sort carries an element through after
+ * its first step left (see _qsort_cmov_insertion_sort()). Each costs a
+ * comparison whether it's needed or not, so with a larger
+ * qsort_def::max_thresh, elements still moving past it finish in an ordinary
+ * loop. */
+#ifndef _QSORT_CMOV_WINDOW
+# define _QSORT_CMOV_WINDOW 8
+#endif
+
+/* Partition sizes (in elements) above which qsort_def::pivot switches from
+ * median-of-three to the ninther and from the ninther to a sampled median. */
+#define _QSORT_NINTHER_THRESH 128
+#define _QSORT_SAMPLE_THRESH  0x4000
+
+/* Threshold of element size before switching to an indirect sort. Define
+ * QSORT_USE_CALIBRATION to use the _QSORT_IND_THRESH_FOR() table of the
+ * <gboing/qsort-calibration.h> generated for this host by
+ * scripts/calibrate_ind_thresh.sh instead, unless _QSORT_IND_THRESH is defined
+ * explicitly.
+ */
+#if defined(QSORT_USE_CALIBRATION) && !defined(_QSORT_IND_THRESH)
+# include <gboing/qsort-calibration.h>
+#endif
+
 #ifndef _QSORT_IND_THRESH
 # define _QSORT_IND_THRESH 64
 #endif
 
+/* Threshold by element alignment and whether elements are copied by an
+ * outlined qsort_def::elem_copy or qsort_def::elem_swap. */
+#ifndef _QSORT_IND_THRESH_FOR
+# define _QSORT_IND_THRESH_FOR(align, outlined) _QSORT_IND_THRESH
+#endif
+
 
 /**
  * @struct qsort_def
@@ -112,7 +181,9 @@
  *
  * @var qsort_def::elem_buf
  * Pointer to an element buffer (should be at least qsort_def::size bytes and
- * aligned to qsort_def::size).
+ * aligned to qsort_def::size). When sorting indirectly, qsort_template()
+ * also swaps index entries through it, so it must then hold one of those as
+ * well, or EINVAL is returned; leave it unset to have it sized for you.
  *
  * @var qsort_def::max_size_bits
  * Maximum number of bits needed to store count of elements. e.g., if
@@ -128,9 +199,133 @@
  *
  * @var qsort_def::max_thresh
  *
+ * @var qsort_def::introsort
+ * (Optional) When non-zero, the depth of each partition is tracked and any
+ * partition that is nested more than 2 * log2(n) levels deep is sorted with
+ * heapsort instead, guaranteeing O(n log n) worst-case time (introsort).
+ *
+ * @var qsort_def::block_size
+ * (Optional) When non-zero, partitioning is performed with branchless block
+ * partitioning (Edelkamp & Weiss, "BlockQuicksort: How Branch Mispredictions
+ * don't affect Quicksort") using blocks of this many elements, rather than
+ * with the classic "collapse the walls" loop. Must not exceed
+ * _QSORT_MAX_BLOCK_SIZE; 64 or 128 are typical values. As in pdqsort, runs
+ * of elements equal to the pivot are detected by comparing the pivot to the
+ * element preceding its partition and are then removed in a single pass.
+ *
+ * @var qsort_def::key_kind
+ * (Optional) Declares that each element is a plain integer or floating point
+ * number of qsort_def::size bytes and that the less or compar function orders
+ * them naturally (ascending). One of QSORT_KEY_UNSIGNED, QSORT_KEY_SIGNED or
+ * QSORT_KEY_FLOAT (float or double). When set, qsort_def::size is 4 or 8 and
+ * the target has vectors wide enough (AVX2 or AVX-512), small partitions are
+ * ordered with a bitonic sorting network in vector registers as they are
+ * discarded, replacing the final insertion sort pass. qsort_def::max_thresh is
+ * then capped to the number of keys a vector holds, less one. Likewise, with
+ * AVX-512 (or AVX2 and BMI2), partitioning compares a vector of keys to the
+ * pivot at a time and compress-stores them to either side (as vqsort and
+ * x86-simd-sort do), taking the place of qsort_def::block_size or the classic
+ * loop.
+ *
+ * @var qsort_def::adaptive
+ * (Optional) When non-zero, the array is first scanned for natural runs, as in
+ * Timsort: maximal non-descending sequences and strictly descending ones, which
+ * are reversed in place. An array that turns out to be a single run is sorted
+ * by that O(n) pass alone. If there are no more than log2(n) + 1 runs, they are
+ * merged instead of being partitioned, using a workspace of n / 2 elements (or
+ * index entries when indirect sorting is used). Like the rest of
+ * qsort_template()'s workspace, it's taken from the supplied buffer or the
+ * stack (within qsort_def::max_stack) if it fits and from
+ * qsort_def::aligned_alloc or the heap otherwise. If there are more runs, the
+ * scan gives up after that many and the array is sorted as usual.
+ *
+ * @var qsort_def::key_prefix
+ * (Optional) Returns a normalized prefix of an element's key: an unsigned
+ * integer such that key_prefix(a) < key_prefix(b) only if a sorts before b
+ * (e.g., a leading unsigned integer field or a signed one with its sign bit
+ * flipped). Only used when sorting indirectly, in which case each index entry
+ * holds the prefix alongside the pointer. Elements are then only compared (and
+ * their memory touched) when their prefixes are equal, which spares a pair of
+ * likely cache misses in most comparisons. The index is twice as large.
+ *
+ * @var qsort_def::pivot
+ * (Optional) The most elaborate pivot selection to use, chosen per partition
+ * by its size. QSORT_PIVOT_MEDIAN3 (the default) always takes the median of
+ * the first, middle and last elements. QSORT_PIVOT_NINTHER uses Tukey's ninther
+ * (the median of three medians of three, as Bentley & McIlroy recommend) for
+ * partitions of more than _QSORT_NINTHER_THRESH elements. QSORT_PIVOT_SAMPLE
+ * additionally sorts an evenly spaced sample of 2 * log2(n) + 1 elements in
+ * place and takes its median for partitions of more than _QSORT_SAMPLE_THRESH
+ * elements. Either way, the least and greatest of the elements sampled are
+ * moved to the first and last places, where they serve as sentinels.
+ *
+ * @var qsort_def::three_way
+ * (Optional) Have the classic partition loop split three ways, grouping
+ * the elements equal to the pivot in the middle and excluding them from both
+ * sub-partitions (Bentley & McIlroy's "fat pivot"), which keeps inputs with
+ * few distinct keys from degrading. QSORT_THREE_WAY_ALWAYS does so for every
+ * partition; QSORT_THREE_WAY_AUTO only when the pivot is equal to the element
+ * preceding its partition, as pdqsort does (such runs are otherwise
+ * re-partitioned until they are small). Not used with qsort_def::block_size
+ * or vector partitioning, which remove such runs already.
+ *
+ * @var qsort_def::dual_pivot
+ * (Optional) When non-zero, quicksort partitions about two pivots at a time
+ * (Yaroslavskiy's dual-pivot quicksort) instead, which moves elements less
+ * often and so favours medium-sized elements that are sorted directly. When
+ * the two pivots are equal, the elements between them are all equal too and
+ * are left alone. This takes the place of qsort_def::block_size, vector
+ * partitioning, qsort_def::three_way and qsort_def::pivot in qsort_template()
+ * and the bucket sorts of sample_sort_template(), while
+ * qsort_template_mt()'s shared partitions and qselect_template() still use a
+ * single pivot.
+ *
+ * @var qsort_def::heap_arity
+ * (Optional) Number of children each node has in the heaps built by
+ * heapify_template() and friends (see heap-template.h), 2 when unset. With 4,
+ * a node's children tend to share a cache line and sifting down visits half as
+ * many levels, at the cost of two more comparisons per level. Not used by the
+ * sorts.
+ *
  * @var qsort_def::index
  * (internal) Pointer to an index buffer when indirect sorting is used.
  *
+ * @var qsort_def::_prefixed
+ * (internal) Non-zero when the index holds struct _qsort_prefixed entries.
+ *
+ * @var qsort_def::_unique
+ * (internal) Set by sort_unique_template() and sort_reduce_template() to have
+ * the final insertion sort pass also drop duplicates and store the number of
+ * distinct elements here (see _qsort_insertion_unique()).
+ *
+ * @var qsort_def::_combine
+ * (internal) The function sort_reduce_template() folds each duplicate into
+ * the element kept with.
+ *
+ * @var qsort_def::_soa
+ * (internal) Non-zero when qsort_soa_template() is sorting, which forces
+ * indirect sorting so that the permutation can be applied to
+ * qsort_def::_columns as well.
+ *
+ * @var qsort_def::_columns
+ * (internal) The payload columns of qsort_soa_template().
+ *
+ * @var qsort_def::_ncolumns
+ * (internal) Number of payload columns.
+ *
+ * @var qsort_def::_column_buf
+ * (internal) Holds an element of each payload column while a permutation cycle
+ * is followed.
+ *
+ * @var qsort_def::_argsort
+ * (internal) Non-zero when argsort_template() or argsort_ptr_template() is
+ * sorting (_QSORT_ARGSORT_INDEX or _QSORT_ARGSORT_PTR), which forces indirect
+ * sorting and stores the sorted index in qsort_def::_argsort_out instead of
+ * applying it.
+ *
+ * @var qsort_def::_argsort_out
+ * (internal) The caller's index or pointer array.
+ *
  * NOTES: alloca cannot be inlined via indirection (see comments):
  * https://github.com/gcc-mirror/gcc/blob/master/gcc/calls.c#L581
  */
@@ -149,10 +344,59 @@ struct qsort_def {
     size_t max_thresh;
     void *(*aligned_alloc)(size_t alignment, size_t size);
     void (*free)(void *buffer);
+    int introsort;
+    size_t block_size;
+    int key_kind;
+    int adaptive;
+    uint64_t (*key_prefix)(const void *elem);
+    int pivot;
+    int three_way;
+    int dual_pivot;
+    size_t heap_arity;
 
     void **index;
+    int _prefixed;
+    size_t *_unique;
+    void (*_combine)(void *dest, const void *src, void *context);
+    int _soa;
+    const struct qsort_column *_columns;
+    size_t _ncolumns;
+    void *_column_buf;
+    int _argsort;
+    void *_argsort_out;
+};
+
+/* A payload column for qsort_soa_template(): n elements of size bytes each,
+ * permuted along with the keys. */
+struct qsort_column {
+    void *base;
+    size_t size;
 };
 
+/* An index entry when qsort_def::key_prefix is used. */
+struct _qsort_prefixed {
+    uint64_t prefix;
+    void *ptr;
+};
+
+/* values for qsort_def::key_kind */
+#define QSORT_KEY_UNSIGNED  1
+#define QSORT_KEY_SIGNED    2
+#define QSORT_KEY_FLOAT     3
+
+/* values for qsort_def::pivot */
+#define QSORT_PIVOT_MEDIAN3 1
+#define QSORT_PIVOT_NINTHER 2
+#define QSORT_PIVOT_SAMPLE  3
+
+/* values for qsort_def::_argsort (internal) */
+#define _QSORT_ARGSORT_INDEX    1
+#define _QSORT_ARGSORT_PTR      2
+
+/* values for qsort_def::three_way */
+#define QSORT_THREE_WAY_AUTO    1
+#define QSORT_THREE_WAY_ALWAYS  2
+
 #if GCC_VERSION < 40700
 
 /* fallback qsort_template function */
@@ -171,6 +415,48 @@ qsort_template(const struct qsort_def *def, void *const pbase,
 
 #else /* GCC_VERSION >= 40700 */
 
+/**
+ * @breif Determine if elements are large enough to sort indirectly.
+ *
+ * Every template must make the same choice for a given def, since some share
+ * buffers sized from it.
+ */
+static gboing_always_inline int
+_qsort_is_indirect(const struct qsort_def *def) {
+    return def->_soa || def->_argsort
+           || def->size > _QSORT_IND_THRESH_FOR(def->align, !!def->elem_copy
+                                                            || !!def->elem_swap);
+}
+
+/**
+ * @breif Size of the elem_buf needed to sort with def.
+ *
+ * An indirect sort swaps index entries through it as well as elements, and
+ * those can be larger than a small key.
+ */
+static gboing_always_inline size_t
+_qsort_elem_buf_size(const struct qsort_def *def) {
+    if (!_qsort_is_indirect(def))
+        return def->size;
+
+    return gboing_max(def->size, def->key_prefix
+                                 ? sizeof(struct _qsort_prefixed)
+                                 : sizeof(void *));
+}
+
+/**
+ * @breif Alignment of the elem_buf needed to sort with def.
+ */
+static gboing_always_inline size_t
+_qsort_elem_buf_align(const struct qsort_def *def) {
+    if (!_qsort_is_indirect(def))
+        return def->align;
+
+    return gboing_max(def->align, def->key_prefix
+                                  ? gboing_alignof(struct _qsort_prefixed)
+                                  : gboing_alignof(void *));
+}
+
 /**
  * @breif Auto-generated element copy function.
  *
@@ -223,6 +509,20 @@ _qsort_copy(const struct qsort_def *def, void *dest, const void *src) {
     }
 }
 
+/**
+ * @brief Copy n elements, with a single memcpy unless qsort_def::elem_copy
+ *        must be called for each.
+ */
+static gboing_always_inline void
+_qsort_copy_n(const struct qsort_def *def, char *dest, const char *src,
+              size_t n) {
+    if (!!def->elem_copy && !def->index) {
+        for (; n; --n, dest += def->size, src += def->size)
+            _qsort_copy(def, dest, src);
+    } else
+        memcpy(dest, src, n * def->size);
+}
+
 static gboing_always_inline void
 _qsort_swap(const struct qsort_def *def, void *a, void *b) {
     if (!!def->elem_swap && !def->index)
@@ -276,22 +576,38 @@ _qsort_ror(const struct qsort_def *def, void *left, void *right) {
  * @param a
  * @param b
  * @param arg
+ *
+ * @return exactly 1 if a is less than b, 0 otherwise. A less function may
+ * return any non-zero value for true, but callers count and mask with this
+ * result, so it's normalized here.
  */
 static gboing_always_inline gboing_flatten int
 _qsort_less(const struct qsort_def *def, void *a, void *b, void *arg) {
 
     if (!!def->index) {
-        a = *((void**)a);
-        b = *((void**)b);
+        if (def->_prefixed) {
+            const struct _qsort_prefixed *pa = a;
+            const struct _qsort_prefixed *pb = b;
+
+            /* only dereference on ties */
+            if (pa->prefix != pb->prefix)
+                return pa->prefix < pb->prefix;
+
+            a = pa->ptr;
+            b = pb->ptr;
+        } else {
+            a = *((void**)a);
+            b = *((void**)b);
+        }
     }
 
     /* determine which compar/less fn to call and adapt it */
     if (!!def->less)
-        return def->less(a, b);
+        return !!def->less(a, b);
     else if (!!def->compar)
         return def->compar(a, b) < 0;
     else if (!!def->less_r)
-        return def->less_r(a, b, arg);
+        return !!def->less_r(a, b, arg);
     else if (!!def->compar_r)
         return def->compar_r(a, b, arg) < 0;
     else {
@@ -310,435 +626,859 @@ typedef struct {
     char *hi;
 } stack_node;
 
+/* A stack node that also records its partition's depth, used in place of
+ * stack_node only with qsort_def::introsort so that the default stack stays
+ * small enough for max_stack. */
+typedef struct {
+    char *lo;
+    char *hi;
+    size_t depth;
+} _qsort_depth_node;
+
 /* The _qsort_push, _qsort_pop  4 #defines implement a very fast in-line stack abstraction. */
 /* The stack needs log (total_elements) entries (we could even subtract
    log(def.max_thresh)).
    */
 
 static gboing_always_inline void
-_qsort_push(stack_node **top, char *low, char *high) {
-    (*top)->lo = low;
-    (*top)->hi = high;
-    ++(*top);
+_qsort_push(const struct qsort_def *def, stack_node **top, char *low,
+            char *high, size_t depth) {
+    if (def->introsort) {
+        _qsort_depth_node *node = (_qsort_depth_node *)*top;
+
+        node->lo = low;
+        node->hi = high;
+        node->depth = depth;
+        *top = (stack_node *)(node + 1);
+    } else {
+        (*top)->lo = low;
+        (*top)->hi = high;
+        ++(*top);
+    }
 }
 
 static gboing_always_inline void
-_qsort_pop(stack_node **top, char **low, char **high) {
-  --(*top);
-  *low = (*top)->lo;
-  *high = (*top)->hi;
+_qsort_pop(const struct qsort_def *def, stack_node **top, char **low,
+           char **high, size_t *depth) {
+  if (def->introsort) {
+    _qsort_depth_node *node = (_qsort_depth_node *)*top - 1;
+
+    *low = node->lo;
+    *high = node->hi;
+    *depth = node->depth;
+    *top = (stack_node *)node;
+  } else {
+    --(*top);
+    *low = (*top)->lo;
+    *high = (*top)->hi;
+    *depth = 0;
+  }
 }
 
-/* Order size using qsort.  This implementation incorporates
-   four optimizations discussed in Sedgewick:
-
-   1. Non-recursive, using an explicit stack of pointer that store the
-      next array partition to sort.  To save time, this maximum amount
-      of space required to store an array of SIZE_MAX is allocated on the
-      stack.  Assuming a 32-bit integer for size_t, this needs
-      only 32 * sizeof(stack_node) == 256 bytes. For 64 bits, 768 bytes
-      or 1024 bytes if uncapped.
-
-   2. Chose the pivot element using a median-of-three decision tree.
-      This reduces the probability of selecting a bad pivot value and
-      eliminates certain extraneous comparisons.
-
-   3. Only qsorts TOTAL_ELEMS / def.max_thresh partitions, leaving
-      insertion sort to order the def.max_thresh items within each partition.
-      This is a big win, since insertion sort is faster for small, mostly
-      sorted array segments.
-
-   4. The larger of the two sub-partitions is always pushed onto the
-      stack first, with the algorithm then concentrating on the
-      smaller partition.  This *guarantees* no more than log (n)
-      stack size is needed (actually O(1) in this case)!  */
+/**
+ * @brief Floor of log2(n) for n > 0.
+ */
+static gboing_always_inline size_t
+_qsort_log2(size_t n) {
+    assert(n);
+    return sizeof(unsigned long long) * 8 - 1
+           - __builtin_clzll((unsigned long long)n);
+}
 
 /**
- * @breif
- *
- * @param def
- *
- * @param buffer
- * (Optional) Temporary memory to use instead of allocating memory on the stack
- * and/or heap. If supplied, it should be aligned to the greater of
- * qsort_def::align or the __alignof__(void *) of a failed assertion / sigbus
- * may result. If not used, a compile-time constant NULL value should be passed
- * to reduce generated code.
- *
- * @param buf_size
- * Size of buffer (if non-null), zero otherwise. Using a compile-time constant
- * value will result in a small reduction in generated code size.
- *
- * @param pbase
- * Element array.
+ * @brief Restore the heap property of the (max) heap rooted at root by sifting
+ *        it down.
  *
- * @param n
- * Number of elements.
+ * The root element is held in def->elem_buf and children are moved up into
+ * the hole, so this costs one copy per level rather than a full swap.
  *
- * @param arg
- * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
- * function.
+ * @param def         the template parameters
+ * @param base        first element of the heap
+ * @param root        index of the element to sift down
+ * @param n           number of elements in the heap
+ * @param arg         context for less_r/compar_r
  */
+static gboing_always_inline gboing_flatten void
+_qsort_sift_down(const struct qsort_def *def, char *base, size_t root,
+                 size_t n, void *arg) {
+    const size_t size = def->size;
+    size_t child;
 
-static gboing_always_inline gboing_flatten int
-qsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
-               void *const pbase, size_t n, void *arg) {
-    /* this copy of def will be mutated to manage indirect sorting if needed */
-    struct qsort_def d = *def;
-    char *base_ptr = (char *) pbase;
-    size_t max_thresh;                      /* ct const */
-
-    /* Use indirect sorting if size is large */
-    const int indirect              = d.size > _QSORT_IND_THRESH; /* ct const */
-    size_t tmp_needed               = 0;  /* can be either ct or rt value */
-    size_t tmp_align                = 0;  /* ct const */
-    size_t buf_used                 = 0;  /* ct const */
-    stack_node *qstack              = 0;  /* rt value */
-    const size_t QSTACK_ALIGN       = gboing_alignof(stack_node);
-    const size_t PTR_ALIGN          = gboing_alignof(void *);
-    size_t pad_size;                      /* ct const */
-    size_t stack_used               = 0;  /* ct const -- note that we omit alignment padding */
-    size_t qstack_size;                   /* ct const */
-    size_t qstack_tmp_offset        = 0;  /* ct const */
-    size_t index_tmp_offset         = 0;  /* ct const */
-    void *tmp_buffer                = NULL; /* rt value */
-    int elem_buf_is_set             = 0;  /*ct const -- a work-around for a bug */
+    _qsort_copy(def, def->elem_buf, &base[root * size]);
 
+    while ((child = 2 * root + 1) < n) {
+        if (child + 1 < n && _qsort_less(def, &base[child * size],
+                                         &base[(child + 1) * size], arg))
+            ++child;
 
-    if (n == 0)
-        /* Avoid lossage with unsigned arithmetic below.  */
-        return 0;
+        if (!_qsort_less(def, def->elem_buf, &base[child * size], arg))
+            break;
 
-    /* Restrict to reasonable value */
-    if (d.align > _QSORT_ALIGN_MAX)
-        d.align = _QSORT_ALIGN_MAX;
+        _qsort_copy(def, &base[root * size], &base[child * size]);
+        root = child;
+    }
 
-    if (d.max_size_bits) {
-        d.max_size_bits = gboing_min(d.max_size_bits, sizeof(size_t) * 8);
-    } else
-        d.max_size_bits = sizeof(size_t) * 8 * 3 / 4;
+    _qsort_copy(def, &base[root * size], def->elem_buf);
+}
 
-    assert(n <= ((size_t)1 << d.max_size_bits) - 1);
+/**
+ * @brief Non-recursive heapsort of the elements lo through hi (inclusive).
+ *
+ * Used as the introsort fallback for partitions that have recursed too deeply.
+ *
+ * @param def         the template parameters
+ * @param lo          leftmost element
+ * @param hi          rightmost element
+ * @param arg         context for less_r/compar_r
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_heapsort(const struct qsort_def *def, char *lo, char *hi, void *arg) {
+    const size_t n = (size_t)(hi - lo) / def->size + 1;
+    size_t i;
 
-    if (!d.max_thresh)
-        d.max_thresh = DEFAULT_MAX_THRESH;
+    for (i = n / 2; i--;)
+        _qsort_sift_down(def, lo, i, n, arg);
 
-    if (!d.max_stack)
-        d.max_stack = 1024;
+    for (i = n; --i;) {
+        _qsort_swap(def, lo, &lo[i * def->size]);
+        _qsort_sift_down(def, lo, 0, i, arg);
+    }
+}
 
-//    if (d.align < GBOING_MIN_ALIGN)
-//        d.align = GBOING_MIN_ALIGN;
+/**
+ * @brief Move the elements at the supplied offsets between the left and right
+ *        sides of a block partition.
+ *
+ * When the number of misplaced elements on each side was equal, they are
+ * swapped in pairs. Otherwise they are rotated as a single cycle through
+ * def->elem_buf, which needs only one copy per element.
+ */
+static gboing_always_inline void
+_qsort_swap_offsets(const struct qsort_def *def, char *first, char *last,
+                    const unsigned char *offsets_l,
+                    const unsigned char *offsets_r,
+                    size_t num, int use_swaps) {
+    const size_t size = def->size;
+    size_t i;
+
+    if (use_swaps) {
+        for (i = 0; i < num; ++i)
+            _qsort_swap(def, first + offsets_l[i] * size,
+                             last  - offsets_r[i] * size);
+    } else if (num) {
+        char *l = first + offsets_l[0] * size;
+        char *r = last  - offsets_r[0] * size;
+
+        _qsort_copy(def, def->elem_buf, l);
+        _qsort_copy(def, l, r);
+
+        for (i = 1; i < num; ++i) {
+            l = first + offsets_l[i] * size;
+            _qsort_copy(def, r, l);
+            r = last - offsets_r[i] * size;
+            _qsort_copy(def, l, r);
+        }
 
-#ifdef GNU_LIBC_SOME_SUCH
-    if (d.max_stack > __MAX_ALLOCA_CUTOFF)
-        d.max_stack = __MAX_ALLOCA_CUTOFF;
-#endif
+        _qsort_copy(def, r, def->elem_buf);
+    }
+}
 
-    d.index = NULL; /* ignore if it was populated by caller */
+/**
+ * @brief Branchless block partition of lo through hi (inclusive) about the
+ *        pivot at lo.
+ *
+ * Adapted from the partition_right_branchless() function of Orson Peters'
+ * pattern-defeating quicksort. The result of each comparison is used to
+ * advance an offset counter rather than to branch, recording the offsets of
+ * elements on the wrong side into small per-side buffers; the misplaced
+ * elements are then exchanged in a batch. The caller must assure that an
+ * element not less than the pivot exists after lo (median-of-three does so).
+ *
+ * @return the final position of the pivot: elements to its left are less
+ *         than it and elements to its right are not.
+ */
+static gboing_always_inline gboing_flatten char *
+_qsort_partition_block(const struct qsort_def *def, char *lo, char *hi,
+                       void *arg) {
+    const size_t size = def->size;
+    const size_t block_size = def->block_size;
+    char *const pivot = lo;
+    char *first = lo;
+    char *last = hi + size;
+
+    gboing_assert_const(block_size);
+    gboing_assert_msg(block_size <= _QSORT_MAX_BLOCK_SIZE,
+                      "block_size exceeds _QSORT_MAX_BLOCK_SIZE");
+
+    /* find the first pair of elements on the wrong side */
+    while (_qsort_less(def, first += size, pivot, arg))
+        ;
+
+    if (first - size == lo)
+        while (first < last && !_qsort_less(def, last -= size, pivot, arg))
+            ;
+    else
+        while (!_qsort_less(def, last -= size, pivot, arg))
+            ;
+
+    if (first < last) {
+        unsigned char offsets_l[_QSORT_MAX_BLOCK_SIZE];
+        unsigned char offsets_r[_QSORT_MAX_BLOCK_SIZE];
+        char *offsets_l_base;
+        char *offsets_r_base;
+        size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+        _qsort_swap(def, first, last);
+        first += size;
+
+        offsets_l_base = first;
+        offsets_r_base = last;
+
+        while (first < last) {
+            /* decide how many elements go to each offset block */
+            const size_t num_unknown = (size_t)(last - first) / size;
+            const size_t left_split  = num_l == 0
+                                     ? (num_r == 0 ? num_unknown / 2
+                                                   : num_unknown)
+                                     : 0;
+            const size_t right_split = num_r == 0
+                                     ? num_unknown - left_split
+                                     : 0;
+            size_t num, i;
+
+            /* fill the offset blocks */
+            if (left_split >= block_size) {
+                for (i = 0; i < block_size; ++i, first += size) {
+                    offsets_l[num_l] = i;
+                    num_l += !_qsort_less(def, first, pivot, arg);
+                }
+            } else {
+                for (i = 0; i < left_split; ++i, first += size) {
+                    offsets_l[num_l] = i;
+                    num_l += !_qsort_less(def, first, pivot, arg);
+                }
+            }
 
-    /* validate required fields are constants */
-    gboing_assert_const(!d.less + !d.compar + !d.less_r + !d.compar_r);
-    gboing_assert_const(d.align);
-    gboing_assert_const(d.size);
-    gboing_assert_msg(!!d.less || !!d.compar || !!d.less_r || !!d.compar_r,
-                      "a less or compar function is required");
+            if (right_split >= block_size) {
+                for (i = 1; i <= block_size; ++i) {
+                    offsets_r[num_r] = i;
+                    num_r += _qsort_less(def, last -= size, pivot, arg);
+                }
+            } else {
+                for (i = 1; i <= right_split; ++i) {
+                    offsets_r[num_r] = i;
+                    num_r += _qsort_less(def, last -= size, pivot, arg);
+                }
+            }
 
-    gboing_assert(gboing_is_pow2(def->align));
+            /* swap elements and update block sizes and boundaries */
+            num = gboing_min(num_l, num_r);
+            _qsort_swap_offsets(def, offsets_l_base, offsets_r_base,
+                                offsets_l + start_l, offsets_r + start_r,
+                                num, num_l == num_r);
+            num_l -= num;
+            num_r -= num;
+            start_l += num;
+            start_r += num;
+
+            if (num_l == 0) {
+                start_l = 0;
+                offsets_l_base = first;
+            }
 
-#if __STDC_VERSION__ >= 201112L
-    gboing_assert(gboing_is_pow2(_Alignof(max_align_t)));
-#endif
+            if (num_r == 0) {
+                start_r = 0;
+                offsets_r_base = last;
+            }
+        }
 
-    gboing_assert_msg(!(d.align & (d.align - 1)),
-                      "align must be a power of two"); /* ??? */
-    gboing_assert_msg(!(d.size % d.align),
-                      "size must be a multiple of align");
+        /* [first, last) is now fully classified, swap the stragglers */
+        if (num_l) {
+            while (num_l--)
+                _qsort_swap(def, offsets_l_base
+                                 + offsets_l[start_l + num_l] * size,
+                            last -= size);
+            first = last;
+        }
 
-    /* verify pbase is really aligned as advertised */
-    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+        if (num_r) {
+            while (num_r--) {
+                _qsort_swap(def, offsets_r_base
+                                 - offsets_r[start_r + num_r] * size,
+                            first);
+                first += size;
+            }
+        }
+    }
 
-    /* perform checks on buffer & buf_size */
-    gboing_assert_early(buffer || !buf_size);
-    gboing_assert_early(((uintptr_t)buffer
-                        % gboing_max(d.align, PTR_ALIGN)) == 0);
+    /* put the pivot in its final place */
+    first -= size;
+    if (first != lo)
+        _qsort_swap(def, lo, first);
 
+    return first;
+}
 
-    gboing_assert_msg(!d.aligned_alloc || !!d.free,
-                      "aligned_alloc requires a free function");
+/**
+ * @brief Partition lo through hi (inclusive) about the pivot at lo, placing
+ *        elements equal to the pivot on the left.
+ *
+ * Adapted from pdqsort's partition_left(). This is used by block partitioning
+ * when the pivot is equal to the element preceding the partition: since that
+ * element is no greater than any in the partition, everything not greater than
+ * the pivot must be equal to it and need not be sorted any further.
+ *
+ * @return the final position of the pivot: elements at or to its left are
+ *         equal to it and elements to its right are greater.
+ */
+static gboing_always_inline gboing_flatten char *
+_qsort_partition_equal(const struct qsort_def *def, char *lo, char *hi,
+                       void *arg) {
+    const size_t size = def->size;
+    char *const pivot = lo;
+    char *first = lo;
+    char *last = hi + size;
+
+    while (_qsort_less(def, pivot, last -= size, arg))
+        ;
+
+    if (last == hi)
+        while (first < last && !_qsort_less(def, pivot, first += size, arg))
+            ;
+    else
+        while (!_qsort_less(def, pivot, first += size, arg))
+            ;
 
-    /* Allocate and/or calculate memory requirements */
+    while (first < last) {
+        _qsort_swap(def, first, last);
 
-    /* ==== d.elem_buf ==== */
-    if (!d.elem_buf) {
+        while (_qsort_less(def, pivot, last -= size, arg))
+            ;
 
-        /* can we use the supplied buffer? */
-        if (buf_size >= d.size) {
-            d.elem_buf = buffer;
-            buf_used += d.size;
-            elem_buf_is_set = 1;
+        while (!_qsort_less(def, pivot, first += size, arg))
+            ;
+    }
 
-        /* can we put it on the stack? */
-        } else if (d.size < d.max_stack) {
-            stack_used += d.size;
-            d.elem_buf = gboing_aligned_alloca(d.align, d.size);
-            elem_buf_is_set = 1;
+    if (last != lo)
+        _qsort_swap(def, lo, last);
 
-            /* This test fails! it may be because gcc is sometimes able to
-             * determine that d.elem_buf isn't used and so never allocates
-             * it, not sure yet. It succeeds if we explicitly use it.*/
-            *((char*)d.elem_buf) = 0;
-            gboing_assert(!!d.elem_buf);
+    return last;
+}
 
-        /* otherwise, it must go on the heap */
-        } else {
-            tmp_needed += d.size;
-            tmp_align = d.align;
+/**
+ * @brief Partition lo through hi (inclusive) three ways about the pivot at lo:
+ *        less, equal and greater.
+ *
+ * This is Bentley & McIlroy's "fat pivot" partition ("Engineering a Sort
+ * Function"): elements equal to the pivot are swapped to either end as they
+ * are found and then swapped into the middle, where they are excluded from
+ * both sub-partitions.
+ *
+ * @param left        receives the first element of the greater partition
+ * @param right       receives the last element of the less partition
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_partition_3way(const struct qsort_def *def, char *lo, char *hi,
+                      char **left, char **right, void *arg) {
+    const size_t size = def->size;
+    char *const pivot = lo;
+    char *pa = lo + size;
+    char *pb = lo + size;
+    char *pc = hi;
+    char *pd = hi;
+    size_t less_bytes;
+    size_t greater_bytes;
+    size_t s;
+
+    for (;;) {
+        while (pb <= pc && !_qsort_less(def, pivot, pb, arg)) {
+            if (!_qsort_less(def, pb, pivot, arg)) {
+                _qsort_swap(def, pa, pb);
+                pa += size;
+            }
+            pb += size;
         }
-    } else
-        elem_buf_is_set = 1;
-
-    /* ==== qsort node stack ==== */
-    /* subtracting max_thresh needs to be tested & verified */
-    qstack_size = sizeof(stack_node) * (d.max_size_bits - d.max_thresh + 1);
-
-    /* keep properly aligned */
-    pad_size = (buf_used % QSTACK_ALIGN)
-             ? QSTACK_ALIGN - (buf_used % QSTACK_ALIGN)
-             : 0;
-
-    /* Can we put qstack on supplied buffer? */
-    if (buf_size >= buf_used + pad_size + qstack_size) {
-
-        buf_used += pad_size;
-        qstack = buffer + buf_used;
-        buf_used += qstack_size;
 
-    /* Can we put it on the stack? */
-    } else if (stack_used + qstack_size <= d.max_stack) {
-        stack_used += qstack_size;
-        qstack = gboing_aligned_alloca(QSTACK_ALIGN, qstack_size);
+        while (pb <= pc && !_qsort_less(def, pc, pivot, arg)) {
+            if (!_qsort_less(def, pivot, pc, arg)) {
+                _qsort_swap(def, pc, pd);
+                pd -= size;
+            }
+            pc -= size;
+        }
 
-    /* otherwise, it must be on the heap */
-    } else {
-        /* if elem_buf is already going there, we need correct alignment */
-        if (tmp_needed) {
-            pad_size = (tmp_needed % QSTACK_ALIGN)
-                       ? QSTACK_ALIGN - (tmp_needed % QSTACK_ALIGN)
-                       : 0;
-            tmp_needed += pad_size;
-            qstack_tmp_offset = tmp_needed;     /* record offset */
-
-            /* otherwise, we'll allocate it with qstack's alignment */
-        } else
-            tmp_align = QSTACK_ALIGN;
+        if (pb > pc)
+            break;
 
-        tmp_needed += qstack_size;
+        _qsort_swap(def, pb, pc);
+        pb += size;
+        pc -= size;
     }
 
-    gboing_assert_const(tmp_align);
-    gboing_assert_const(tmp_needed);
+    less_bytes    = (size_t)(pb - pa);
+    greater_bytes = (size_t)(pd - pc);
 
-    /* ==== indirection buffer ==== -- never goes on stack */
-    if (indirect) {
-        size_t index_size = sizeof(void *) * n;     /* rt value */
+    /* swap the equal elements from the ends into the middle */
+    for (s = gboing_min((size_t)(pa - lo), less_bytes); s; s -= size)
+        _qsort_swap(def, lo + s - size, pb - s);
 
-        /* try buffer first */
-        pad_size = (buf_used % PTR_ALIGN)
-                   ? PTR_ALIGN - (buf_used % PTR_ALIGN)
-                   : 0;
+    for (s = gboing_min(greater_bytes, (size_t)(hi - pd)); s; s -= size)
+        _qsort_swap(def, pb + s - size, hi + size - s);
 
-        if (buf_size >= buf_used + pad_size + index_size) {
-            buf_used += pad_size;
-            d.index = buffer + buf_used;
+    /* don't step past lo or hi when either side is empty */
+    *right = less_bytes    ? lo + less_bytes - size    : lo;
+    *left  = greater_bytes ? hi + size - greater_bytes : hi;
+}
 
-        /* otherwise we'll allocate heap space */
-        } else {
-           if (tmp_needed) {
-                /* keep properly aligned if other objects are going on this buffer */
-                pad_size = (tmp_needed % PTR_ALIGN)
-                           ? PTR_ALIGN - (tmp_needed % PTR_ALIGN)
-                           : 0;
-                tmp_needed += pad_size;
-
-                index_tmp_offset = tmp_needed;
-            } else {
-                /* tmp_align becomes rt value here */
-                tmp_align = PTR_ALIGN;
-            }
+/**
+ * @brief Partition lo through hi (inclusive) about two pivots.
+ *
+ * Yaroslavskiy's dual-pivot partition, as in Java 7's Arrays.sort(): the
+ * pivots are the second and fourth of five evenly spaced elements (or lo and hi
+ * for fewer than 16) and the elements are split into those less than the
+ * first, those between the two and those greater than the second. Each element
+ * is moved at most about once per level, of which there are log3(n) rather
+ * than log2(n).
+ *
+ * @param p1          receives the final position of the lesser pivot
+ * @param p2          receives the final position of the greater pivot
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_partition_dual(const struct qsort_def *def, char *lo, char *hi,
+                      char **p1, char **p2, void *arg) {
+    const size_t size = def->size;
+    const size_t n = (size_t)(hi - lo) / size + 1;
+    char *lt;
+    char *gt;
+    char *k;
+
+    if (n >= 16) {
+        const size_t seventh = ((n >> 3) + (n >> 6) + 1) * size;
+        char *e[5];
+        unsigned i;
+
+        e[2] = lo + size * ((n - 1) >> 1);
+        e[1] = e[2] - seventh;
+        e[0] = e[1] - seventh;
+        e[3] = e[2] + seventh;
+        e[4] = e[3] + seventh;
+
+        /* insertion sort the five */
+        for (i = 1; i < 5; ++i) {
+            unsigned j;
+
+            for (j = i; j && _qsort_less(def, e[j], e[j - 1], arg); --j)
+                _qsort_swap(def, e[j], e[j - 1]);
+        }
 
-            gboing_assert_const(tmp_needed);
-            gboing_assert_const(index_tmp_offset);
-            /* tmp_needed becomes a run-time value here due to index_size */
-            tmp_needed += index_size;
+        _qsort_swap(def, e[1], lo);
+        _qsort_swap(def, e[3], hi);
+    } else if (_qsort_less(def, hi, lo, arg))
+        _qsort_swap(def, lo, hi);
+
+    /* [lo + 1, lt) < *lo, (gt, hi - 1] > *hi and the rest are in between */
+    lt = lo + size;
+    gt = hi - size;
+
+    for (k = lt; k <= gt; k += size) {
+        if (_qsort_less(def, k, lo, arg)) {
+            if (k != lt)
+                _qsort_swap(def, k, lt);
+            lt += size;
+        } else if (_qsort_less(def, hi, k, arg)) {
+            while (k < gt && _qsort_less(def, hi, gt, arg))
+                gt -= size;
+
+            if (k != gt)
+                _qsort_swap(def, k, gt);
+            gt -= size;
+
+            if (_qsort_less(def, k, lo, arg)) {
+                if (k != lt)
+                    _qsort_swap(def, k, lt);
+                lt += size;
+            }
         }
     }
 
-    /* allocate if heap space needed */
-    if (tmp_needed) {
-        if (!!d.aligned_alloc)
-            tmp_buffer = d.aligned_alloc(tmp_align, tmp_needed);
-        else
-            tmp_buffer = gboing_aligned_alloc(tmp_align, tmp_needed);
+    /* move the pivots into place */
+    lt -= size;
+    gt += size;
 
+    if (lt != lo)
+        _qsort_swap(def, lo, lt);
 
-        if (!tmp_buffer)
-            return ENOMEM;
+    if (gt != hi)
+        _qsort_swap(def, hi, gt);
 
-        if (!d.elem_buf)
-            d.elem_buf = tmp_buffer;
-        else
-            gboing_assert(elem_buf_is_set);
+    *p1 = lt;
+    *p2 = gt;
+}
+
+/**
+ * @brief Copy element i of each payload column to or from def->_column_buf.
+ */
+static gboing_always_inline void
+_qsort_stash_columns(const struct qsort_def *def, size_t i, int restore) {
+    char *buf = (char *)def->_column_buf;
+    size_t c;
+
+    for (c = 0; c < def->_ncolumns; ++c) {
+        const size_t size = def->_columns[c].size;
+        char *const elem = (char *)def->_columns[c].base + i * size;
 
-        if (!qstack)
-            qstack = tmp_buffer + qstack_tmp_offset;
+        if (restore)
+            memcpy(elem, buf, size);
+        else
+            memcpy(buf, elem, size);
 
-        if (indirect && !d.index)
-            d.index = tmp_buffer + index_tmp_offset;
+        buf += size;
     }
+}
 
-    /* now as long as we haven't erred in any of our padding calculation, this
-     * should never cause bad code generation*/
-    d.elem_buf    = gboing_assume_aligned(d.elem_buf, d.align);
-    qstack        = gboing_assume_aligned(qstack, QSTACK_ALIGN);
-    d.index       = gboing_assume_aligned(d.index, PTR_ALIGN);
-
-    /* but just to be safe, let's verify it for now */
-    assert(!((uintptr_t)d.elem_buf % d.align));
-    assert(!((uintptr_t)qstack % QSTACK_ALIGN));
-    assert(!((uintptr_t)d.index % PTR_ALIGN));
-
-    /* if using indirection, we'll now swap out d.size and d.align */
-    if (indirect) {
-        size_t i;
+/**
+ * @brief Copy element src of each payload column over element dest.
+ *
+ * Common sizes get a constant-sized copy rather than a memcpy call.
+ */
+static gboing_always_inline void
+_qsort_move_columns(const struct qsort_def *def, size_t dest, size_t src) {
+    size_t c;
+
+    for (c = 0; c < def->_ncolumns; ++c) {
+        const size_t size = def->_columns[c].size;
+        char *const base = (char *)def->_columns[c].base;
+
+        switch (size) {
+            case 1:  memcpy(&base[dest], &base[src], 1);
+                     break;
+            case 2:  memcpy(&base[dest * 2], &base[src * 2], 2);
+                     break;
+            case 4:  memcpy(&base[dest * 4], &base[src * 4], 4);
+                     break;
+            case 8:  memcpy(&base[dest * 8], &base[src * 8], 8);
+                     break;
+            default: memcpy(&base[dest * size], &base[src * size], size);
+        }
+    }
+}
 
-        d.size = sizeof(void *);
-        d.align = PTR_ALIGN;
+/**
+ * @brief Size of each entry argsort_template() writes: 32-bit indices when
+ *        qsort_def::max_size_bits allows, 64-bit otherwise.
+ */
+static gboing_always_inline size_t
+_qsort_argsort_index_size(const struct qsort_def *def) {
+    return def->max_size_bits <= 32 ? sizeof(uint32_t) : sizeof(uint64_t);
+}
 
-        assert(!((uintptr_t)d.index & (d.align - 1)));
+/**
+ * @brief Determine if the sorted index can be built directly in
+ *        def->_argsort_out, which is when its entries are plain pointers of
+ *        the same size.
+ */
+static gboing_always_inline int
+_qsort_argsort_in_place(const struct qsort_def *def) {
+    if (!def->_argsort || def->key_prefix)
+        return 0;
 
-        for (i = n; i--;)
-            d.index[i] = base_ptr + i * def->size;
+    return def->_argsort == _QSORT_ARGSORT_PTR
+           || _qsort_argsort_index_size(def) == sizeof(void *);
+}
 
-        base_ptr = (char *) d.index;
+/**
+ * @brief Store a sorted index in def->_argsort_out as pointers or as element
+ *        indices.
+ *
+ * Each entry is written at or before the index entry it's read from, so
+ * ascending order is safe when they share memory.
+ *
+ * @param def         the template parameters (of the elements, not the index)
+ * @param pbase       element array
+ * @param index       pointers to the elements of pbase in sorted order
+ * @param n           number of elements
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_argsort_store(const struct qsort_def *def, const void *pbase,
+                     void **index, size_t n) {
+    char *const out = (char *)def->_argsort_out;
+    size_t i;
+
+    if (def->_argsort == _QSORT_ARGSORT_PTR) {
+        if ((void *)out != (void *)index)
+            memcpy(out, index, n * sizeof(void *));
+
+    } else if (_qsort_argsort_index_size(def) == sizeof(uint32_t)) {
+        for (i = 0; i < n; ++i) {
+            const uint32_t k = ((char *)index[i] - (char *)pbase) / def->size;
+            memcpy(&out[i * sizeof(k)], &k, sizeof(k));
+        }
 
+    } else {
+        for (i = 0; i < n; ++i) {
+            const uint64_t k = ((char *)index[i] - (char *)pbase) / def->size;
+            memcpy(&out[i * sizeof(k)], &k, sizeof(k));
+        }
     }
+}
 
-    /* now that we have d.size figured out... */
-    max_thresh = d.max_thresh * d.size;
-
-    /* These locals should still be compile-time constants */
-    gboing_assert_const(indirect);
-    gboing_assert_const(max_thresh);
-    gboing_assert_const(buf_used);       /* note any index size is omitted */
-    gboing_assert_const(QSTACK_ALIGN);
-    gboing_assert_const(PTR_ALIGN);
-    gboing_assert_const(pad_size);
-    gboing_assert_const(stack_used);
-    gboing_assert_const(qstack_size);
-    gboing_assert_const(qstack_tmp_offset);
-    /* gboing_assert_const(index_tmp_offset); broken test!!! */
+/**
+ * @brief Rearrange an array of elements into the order given by an index.
+ *
+ * Each permutation cycle is followed from its first element, so every element
+ * is copied only once plus once per cycle through def->elem_buf. The index is
+ * overwritten in the process (each entry ends up pointing to its own slot).
+ * When def->_soa is set, each payload column is moved the same way in the same
+ * pass, its cycle's first element held in def->_column_buf.
+ *
+ * @param def         the template parameters (of the elements, not the index)
+ * @param pbase       element array
+ * @param index       pointers to the elements of pbase in their desired order
+ * @param n           number of elements
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_apply_index(const struct qsort_def *def, void *const pbase,
+                   void **index, size_t n) {
+    const size_t size = def->size;
+    size_t i;     /* current index & element entries */
+    char *ip;     /* pointer to the current element */
+    char *kp;     /* current element at index[i] */
+
+    for (i = 0, ip = (char *)pbase; i < n; ++i, ip += size) {
+        if ((kp = index[i]) != ip) {
+            size_t j = i;
+            char *jp = ip;
+            _qsort_copy(def, def->elem_buf, ip);
+            if (def->_soa)
+                _qsort_stash_columns(def, i, 0);
 
+            do {
+                size_t k = (kp - (char *)pbase) / size;
+                index[j] = jp;
+                _qsort_copy(def, jp, kp);
+                if (def->_soa)
+                    _qsort_move_columns(def, j, k);
+                j = k;
+                jp = kp;
+                kp = index[k];
+            } while (kp != ip);
+
+            index[j] = jp;
+            _qsort_copy(def, jp, def->elem_buf);
+            if (def->_soa)
+                _qsort_stash_columns(def, j, 1);
+        }
+    }
+}
 
-    /* ==== Merge sort ==== */
-    if (n > d.max_thresh) {
-        char *lo = base_ptr;
-        char *hi = &lo[d.size * (n - 1)];
-        stack_node *top = qstack;
+/**
+ * @brief Determine if insertion sort should use binary insertion.
+ *
+ * That is when elements are sorted directly, are larger than
+ * _QSORT_BININS_THRESH bytes (so shifting them with a single memmove pays) and
+ * are compared by a three-way compar or compar_r function, which is more work
+ * per comparison than a less function. An index isn't: its entries are
+ * already moved as single pointers and the slots are rarely more than
+ * qsort_def::max_thresh away, too few for a binary search to save comparisons.
+ */
+static gboing_always_inline int
+_qsort_binary_insertion(const struct qsort_def *def) {
+    return !def->index && (!!def->compar || !!def->compar_r)
+           && def->size > _QSORT_BININS_THRESH;
+}
 
-        _qsort_push(&top, NULL, NULL);
+/**
+ * @brief Insertion sort finding each slot with O(log k) comparisons.
+ *
+ * Each element's slot is bracketed by galloping left from it (which costs one
+ * comparison when it's already in place) and then found by binary search. The
+ * elements in between are shifted with a single memmove rather than one copy
+ * at a time, unless an outlined qsort_def::elem_copy must be used. Like the
+ * linear scan, equal elements keep their order.
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_binary_insertion_sort(const struct qsort_def *def, char *base_ptr,
+                             size_t n, void *arg) {
+    const size_t size = def->size;
+    size_t right;
+
+    for (right = 1; right < n; ++right) {
+        char *const x = &base_ptr[right * size];
+        size_t hi = right;              /* first element known greater */
+        size_t lo;                      /* an element known not greater */
+        size_t step;
+
+        for (step = 1;; step <<= 1) {
+            lo = hi > step ? hi - step : 0;
+
+            if (!_qsort_less(def, x, &base_ptr[lo * size], arg))
+                break;
+
+            hi = lo;
+            if (!lo)
+                break;
+        }
 
-        while (qstack < top) {
-            char *left_ptr;
-            char *right_ptr;
+        if (hi == right)
+            continue;
 
-            /* Select median value from among LO, MID, and HI. Rearrange
-               LO and HI so the three values are sorted. This lowers the
-               probability of picking a pathological pivot value and
-               skips a comparison for both the LEFT_PTR and RIGHT_PTR in
-               the while loops. */
+        if (hi) {
+            while (hi - lo > 1) {
+                const size_t mid = lo + ((hi - lo) >> 1);
 
-            char *mid = lo + d.size * ((hi - lo) / d.size >> 1);
+                if (_qsort_less(def, x, &base_ptr[mid * size], arg))
+                    hi = mid;
+                else
+                    lo = mid;
+            }
+        }
 
-            if (_qsort_less(&d, (void *) mid, (void *) lo, arg))
-                _qsort_swap(&d, mid, lo);
+        if (!!def->elem_copy && !def->index)
+            _qsort_ror(def, &base_ptr[hi * size], x);
+        else {
+            char *const slot = gboing_assume_aligned(&base_ptr[hi * size],
+                                                     def->align);
 
-            if (_qsort_less(&d, (void *) hi, (void *) mid, arg)) {
-                _qsort_swap(&d, mid, hi);
+            _qsort_copy(def, def->elem_buf, x);
+            memmove(slot + size, slot, (right - hi) * size);
+            _qsort_copy(def, slot, def->elem_buf);
+        }
+    }
+}
 
-                if (_qsort_less(&d, (void *) mid, (void *) lo, arg))
-                    _qsort_swap(&d, mid, lo);
-            }
+/**
+ * @brief Determine if insertion sort should be branchless.
+ *
+ * That is for scalar elements (up to 8 bytes and a power of two, where
+ * _QSORT_ARCH_MAX_INDEX_MULT allows indexed addressing) sorted directly with a
+ * less or less_r function, whose results are cheap to turn into conditional
+ * moves instead of branches that mispredict about half the time.
+ */
+static gboing_always_inline int
+_qsort_cmov_insertion(const struct qsort_def *def) {
+    return (!!def->less || !!def->less_r) && !def->index && !def->elem_copy
+           && gboing_is_pow2(def->size) && def->size <= sizeof(uint64_t)
+           && def->size <= _QSORT_ARCH_MAX_INDEX_MULT;
+}
 
-            left_ptr  = lo + d.size;
-            right_ptr = hi - d.size;
+/**
+ * @brief Insertion sort using conditional moves instead of branches.
+ *
+ * The smallest of the first qsort_def::max_thresh + 1 elements is found
+ * without branching and becomes the sentinel. An element not less than its
+ * left neighbour stays put after that one comparison, the common case on nearly
+ * sorted data, where the branch is well predicted. Any other element moves one
+ * slot left and is then carried through up to qsort_def::max_thresh more (at
+ * most _QSORT_CMOV_WINDOW), every one of which is rewritten with a selected
+ * value: the element to its left while the one being inserted is less, the
+ * inserted element where it comes to rest or its own value after that. That's
+ * one comparison per slot, or max_thresh + 1 in all, however far it moves. As
+ * partitions are discarded at no more than max_thresh + 1 elements, an element
+ * is rarely further than that from its place, but if it is, it's carried the
+ * rest of the way with the usual (now well predicted) loop.
+ *
+ * The masks are made by negating _qsort_less()'s result, which is therefore
+ * relied upon to be exactly 0 or 1.
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_cmov_insertion_sort(const struct qsort_def *def, char *base_ptr,
+                           size_t n, void *arg) {
+    const size_t size = def->size;
+    const size_t window = gboing_min(def->max_thresh,
+                                     (size_t)_QSORT_CMOV_WINDOW);
+    const size_t thresh = gboing_min(n, def->max_thresh + 1);
+    size_t smallest = 0;
+    size_t right;
+
+    for (right = 1; right < thresh; ++right) {
+        const size_t lt = _qsort_less(def, &base_ptr[right * size],
+                                      &base_ptr[smallest * size], arg);
+
+        smallest += (right - smallest) & -lt;
+    }
 
-            /* Here's the famous ``collapse the walls'' section of qsort.
-               Gotta like those tight inner loops!  They are the main reason
-               that this algorithm runs much faster than others. */
-            do {
-              while (_qsort_less (&d, (void *) left_ptr, (void *) mid, arg))
-                left_ptr += d.size;
-
-              while (_qsort_less (&d, (void *) mid, (void *) right_ptr, arg))
-                right_ptr -= d.size;
-
-                if (left_ptr < right_ptr) {
-                    _qsort_swap(&d, left_ptr, right_ptr);
-
-                    if (mid == left_ptr)
-                        mid = right_ptr;
-                    else if (mid == right_ptr)
-                        mid = left_ptr;
-
-                    left_ptr += d.size;
-                    right_ptr -= d.size;
-                } else if (left_ptr == right_ptr) {
-                    left_ptr += d.size;
-                    right_ptr -= d.size;
-                    break;
-                }
-            } while (left_ptr <= right_ptr);
+    if (smallest)
+        _qsort_swap(def, &base_ptr[smallest * size], base_ptr);
+
+    for (right = 2; right < n; ++right) {
+        const size_t stop = right > window ? right - window : 1;
+        uint64_t x = 0;
+        size_t moving = 1;      /* x hasn't come to rest yet */
+        size_t k;
+
+        /* elements already in place are the rule on nearly sorted data, where
+         * this branch is well predicted and saves the whole window */
+        if (!_qsort_less(def, &base_ptr[right * size],
+                         &base_ptr[(right - 1) * size], arg))
+            continue;
+
+        _qsort_copy(def, def->elem_buf, &base_ptr[right * size]);
+        _qsort_copy(def, &base_ptr[right * size],
+                    &base_ptr[(right - 1) * size]);
+        memcpy(&x, def->elem_buf, size);
+
+        for (k = right - 1; k >= stop; --k) {
+            char *const p = &base_ptr[k * size];
+            const size_t lt = _qsort_less(def, def->elem_buf, p - size, arg)
+                              & moving;
+            /* masks rather than ?:, which gcc turns back into branches */
+            const uint64_t lt_mask = -(uint64_t)lt;
+            const uint64_t moving_mask = -(uint64_t)moving;
+            uint64_t prev = 0;
+            uint64_t cur = 0;
+            uint64_t v;
+
+            memcpy(&prev, p - size, size);
+            memcpy(&cur, p, size);
+            v = (prev & lt_mask)
+                | (~lt_mask & ((x & moving_mask) | (cur & ~moving_mask)));
+            memcpy(p, &v, size);
+            moving = lt;
+        }
 
-            /* Set up pointers for next iteration.  First determine whether
-               left and right partitions are below the threshold size.  If so,
-               ignore one or both.  Otherwise, push the larger partition's
-               bounds on the stack and continue sorting the smaller one. */
+        if (gboing_unlikely(moving)) {
+            /* the slot left behind at stop - 1 is free */
+            for (k = stop - 1;
+                 k && _qsort_less(def, def->elem_buf,
+                                  &base_ptr[(k - 1) * size], arg);
+                 --k)
+                _qsort_copy(def, &base_ptr[k * size],
+                            &base_ptr[(k - 1) * size]);
 
-            if ((size_t)(right_ptr - lo) <= max_thresh) {
-                if ((size_t)(hi - left_ptr) <= max_thresh)
-                    /* Ignore both small partitions. */
-                    _qsort_pop(&top, &lo, &hi);
-                else
-                    /* Ignore small left partition. */
-                    lo = left_ptr;
-            } else if ((size_t)(hi - left_ptr) <= max_thresh) {
-                /* Ignore small right partition. */
-                hi = right_ptr;
-            } else if ((right_ptr - lo) > (hi - left_ptr)) {
-                /* Push larger left partition indices. */
-                _qsort_push(&top, lo, right_ptr);
-                lo = left_ptr;
-            } else {
-                /* Push larger right partition indices. */
-                _qsort_push(&top, left_ptr, hi);
-                hi = right_ptr;
-            }
+            _qsort_copy(def, &base_ptr[k * size], def->elem_buf);
         }
     }
+}
 
-    /* ==== Insertion sort ==== */
+/**
+ * @brief Insertion sort of the n elements at base_ptr.
+ *
+ * The smallest element must be within the first def->max_thresh + 1 elements,
+ * as is the case after the quicksort phase of qsort_template() (or if n is no
+ * greater than that). It is moved to the front first so that it can serve as a
+ * sentinel for the inner loop.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element
+ * @param n           number of elements
+ * @param arg         context for less_r/compar_r
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_insertion_sort(const struct qsort_def *def, char *base_ptr, size_t n,
+                      void *arg) {
+    const size_t max_thresh = def->max_thresh * def->size;
 
-    /* Once the BASE_PTR array is partially sorted by the merge sort, the rest
-     * is completely sorted using insertion sort, since this is efficient
-     * for partitions below d.max_thresh size. BASE_PTR points to the beginning
-     * of the array to sort, and END_PTR points at the very last element in
-     * the array (*not* one beyond it!). */
+    if (_qsort_binary_insertion(def)) {
+        _qsort_binary_insertion_sort(def, base_ptr, n, arg);
 
+    } else if (_qsort_cmov_insertion(def)) {
+        _qsort_cmov_insertion_sort(def, base_ptr, n, arg);
 
     /* if element size is a power of two, indexed addressing will be more
      * efficient in most cases */
-    if (gboing_is_pow2(d.size) && d.size <= _QSORT_ARCH_MAX_INDEX_MULT) {
-        const size_t thresh = gboing_min(n, d.max_thresh + 1);
+    } else if (gboing_is_pow2(def->size)
+               && def->size <= _QSORT_ARCH_MAX_INDEX_MULT) {
+        const size_t thresh = gboing_min(n, def->max_thresh + 1);
         size_t left, right;
         void *smallest;
 
@@ -747,20 +1487,20 @@ qsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
          * and the operation speeds up insertion sort's inner loop. */
 
         for (smallest = base_ptr, right = 1; right < thresh; ++right) {
-            char *p = base_ptr + right * d.size;
+            char *p = base_ptr + right * def->size;
 
-            if (_qsort_less(&d, p, smallest, arg))
+            if (_qsort_less(def, p, smallest, arg))
                 smallest = p;
         }
 
         if (smallest != base_ptr)
-            _qsort_swap(&d, smallest, base_ptr);
+            _qsort_swap(def, smallest, base_ptr);
 
         for (right = 2; right < n; ++right) {
             left = right - 1;
 
-            while (_qsort_less(&d, &base_ptr[right * d.size],
-                                   &base_ptr[left  * d.size], arg)) {
+            while (_qsort_less(def, &base_ptr[right * def->size],
+                                   &base_ptr[left  * def->size], arg)) {
                 assert(left);
                 --left;
             }
@@ -768,11 +1508,11 @@ qsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
             ++left;
 
             if (left != right)
-                _qsort_ror(&d, &base_ptr[left * d.size], &base_ptr[right * d.size]);
+                _qsort_ror(def, &base_ptr[left * def->size], &base_ptr[right * def->size]);
         }
     } else {
         /* if not a power of two, use ptr arithmetic */
-        char *const end_ptr = &base_ptr[d.size * (n - 1)];
+        char *const end_ptr = &base_ptr[def->size * (n - 1)];
         char *tmp_ptr = base_ptr;
         char *thresh = gboing_min(end_ptr, base_ptr + max_thresh);
         register char *run_ptr;
@@ -781,71 +1521,1478 @@ qsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
            array's beginning.  This is the smallest array element,
            and the operation speeds up insertion sort's inner loop. */
 
-        for (run_ptr = tmp_ptr + d.size; run_ptr <= thresh; run_ptr += d.size)
-            if (_qsort_less(&d, (void *) run_ptr, (void *) tmp_ptr, arg))
+        for (run_ptr = tmp_ptr + def->size; run_ptr <= thresh; run_ptr += def->size)
+            if (_qsort_less(def, (void *) run_ptr, (void *) tmp_ptr, arg))
                 tmp_ptr = run_ptr;
 
         if (tmp_ptr != base_ptr)
-            _qsort_swap(&d, tmp_ptr, base_ptr);
+            _qsort_swap(def, tmp_ptr, base_ptr);
 
         /* Insertion sort, running from left-hand-side up to right-hand-side.  */
 
-        run_ptr = base_ptr + d.size;
+        run_ptr = base_ptr + def->size;
 
-        while ((run_ptr += d.size) <= end_ptr) {
-            tmp_ptr = run_ptr - d.size;
+        while ((run_ptr += def->size) <= end_ptr) {
+            tmp_ptr = run_ptr - def->size;
 
-            while (_qsort_less(&d, (void *) run_ptr, (void *) tmp_ptr, arg))
-                tmp_ptr -= d.size;
+            while (_qsort_less(def, (void *) run_ptr, (void *) tmp_ptr, arg))
+                tmp_ptr -= def->size;
 
-            tmp_ptr += d.size;
+            tmp_ptr += def->size;
 
             if (tmp_ptr != run_ptr)
-                _qsort_ror(&d, tmp_ptr, run_ptr);
+                _qsort_ror(def, tmp_ptr, run_ptr);
+        }
+    }
+}
+
+/**
+ * @brief Insertion sort that also drops duplicates (or folds them into the
+ *        element kept with def->_combine).
+ *
+ * As with _qsort_insertion_sort(), each element must be no more than
+ * def->max_thresh from its place, so once the element at right has been
+ * inserted, nothing will be inserted before right - max_thresh again. The
+ * elements before that are final and a second cursor, trailing that far
+ * behind, compacts them to the front while they're still in cache.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element
+ * @param n           number of elements, at least one
+ * @param arg         context for less_r/compar_r and combine
+ *
+ * @return the number of distinct elements, now at the front of the array.
+ */
+static gboing_always_inline gboing_flatten size_t
+_qsort_insertion_unique(const struct qsort_def *def, char *base_ptr, size_t n,
+                        void *arg) {
+    const size_t size = def->size;
+    const size_t thresh = gboing_min(n, def->max_thresh + 1);
+    char *smallest = base_ptr;
+    size_t kept = 1;                /* distinct elements at the front */
+    size_t next = 1;                /* next final element to compact */
+    size_t right;
+
+    assert(n);
+
+    for (right = 1; right < thresh; ++right)
+        if (_qsort_less(def, &base_ptr[right * size], smallest, arg))
+            smallest = &base_ptr[right * size];
+
+    if (smallest != base_ptr)
+        _qsort_swap(def, smallest, base_ptr);
+
+    for (right = 1; right <= n + def->max_thresh; ++right) {
+        /* elements before right - max_thresh are final */
+        for (; next + def->max_thresh < right && next < n; ++next) {
+            char *const last = &base_ptr[(kept - 1) * size];
+            char *const p = &base_ptr[next * size];
+
+            if (_qsort_less(def, last, p, arg)) {
+                if (kept++ != next)
+                    _qsort_copy(def, last + size, p);
+            } else if (!!def->_combine)
+                def->_combine(last, p, arg);
+        }
+
+        if (right < n) {
+            char *p = &base_ptr[right * size];
+
+            _qsort_copy(def, def->elem_buf, p);
+            for (; _qsort_less(def, def->elem_buf, p - size, arg); p -= size)
+                _qsort_copy(def, p, p - size);
+
+            assert((size_t)(p - base_ptr) / size + def->max_thresh >= right);
+
+            if (p != &base_ptr[right * size])
+                _qsort_copy(def, p, def->elem_buf);
         }
     }
 
+    return kept;
+}
 
-    /* if we used indirect sorting, now we have to re-arrange the array. */
-    if (indirect) {
-        size_t i;     /* current index & element entries */
-        char *ip;     /* pointer to the current element */
-        char *kp;     /* current element at index[i] */
-        void **index = d.index;
+/**
+ * @brief Reverse the elements from lo to hi (inclusive).
+ */
+static gboing_always_inline void
+_qsort_reverse(const struct qsort_def *def, char *lo, char *hi) {
+    for (; lo < hi; lo += def->size, hi -= def->size)
+        _qsort_swap(def, lo, hi);
+}
+
+/**
+ * @brief Find the natural runs of the n elements at base_ptr, reversing the
+ *        strictly descending ones.
+ *
+ * Descending runs must be strict so that reversing one never moves an element
+ * past one that's equal to it.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element
+ * @param n           number of elements
+ * @param ends        receives the index one past the end of each run
+ * @param max_runs    give up after finding this many runs
+ * @param arg         context for less_r/compar_r
+ *
+ * @return the number of runs or max_runs + 1 if there are more than max_runs.
+ */
+static gboing_always_inline gboing_flatten size_t
+_qsort_find_runs(const struct qsort_def *def, char *base_ptr, size_t n,
+                 size_t *ends, size_t max_runs, void *arg) {
+    const size_t size = def->size;
+    size_t runs = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t j = i + 1;
+
+        if (runs == max_runs)
+            return max_runs + 1;
+
+        if (j < n && _qsort_less(def, base_ptr + j * size,
+                                 base_ptr + i * size, arg)) {
+            while (++j < n && _qsort_less(def, base_ptr + j * size,
+                                          base_ptr + (j - 1) * size, arg))
+                ;
+            _qsort_reverse(def, base_ptr + i * size, base_ptr + (j - 1) * size);
+        } else {
+            while (j < n && !_qsort_less(def, base_ptr + j * size,
+                                         base_ptr + (j - 1) * size, arg))
+                ++j;
+        }
 
-        d.size  = def->size;
-        d.align = def->align;
-        d.index = NULL;
-
-        for (i = 0, ip = (char *)pbase; i < n; ++i, ip += d.size) {
-            if ((kp = index[i]) != ip) {
-                size_t j = i;
-                char *jp = ip;
-                _qsort_copy(&d, d.elem_buf, ip);
-
-                do {
-                    size_t k = (kp - (char *)pbase) / d.size;
-                    index[j] = jp;
-                    _qsort_copy(&d, jp, kp);
-                    j = k;
-                    jp = kp;
-                    kp = index[k];
-                } while (kp != ip);
+        ends[runs++] = j;
+        i = j;
+    }
 
-                index[j] = jp;
-                _qsort_copy(&d, jp, d.elem_buf);
+    return runs;
+}
+
+/**
+ * @brief Merge the adjacent sorted runs of nl elements at lo and nr elements
+ *        following it in place, copying the shorter of the two to work.
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_merge_runs(const struct qsort_def *def, char *lo, size_t nl, size_t nr,
+                  char *work, void *arg) {
+    const size_t size = def->size;
+    char *const mid = lo + nl * size;
+    char *const hi = mid + nr * size;
+
+    /* already in order */
+    if (!_qsort_less(def, mid, mid - size, arg))
+        return;
+
+    if (nl <= nr) {
+        char *l = work;
+        char *const l_end = work + nl * size;
+        char *r = mid;
+        char *dest = lo;
+
+        _qsort_copy_n(def, work, lo, nl);
+
+        while (l < l_end && r < hi) {
+            if (_qsort_less(def, r, l, arg)) {
+                _qsort_copy(def, dest, r);
+                r += size;
+            } else {
+                _qsort_copy(def, dest, l);
+                l += size;
+            }
+            dest += size;
+        }
+
+        _qsort_copy_n(def, dest, l, (size_t)(l_end - l) / size);
+    } else {
+        char *l = mid;
+        char *r = work + nr * size;
+        char *dest = hi;
+
+        _qsort_copy_n(def, work, mid, nr);
+
+        while (l > lo && r > work) {
+            dest -= size;
+            if (_qsort_less(def, r - size, l - size, arg)) {
+                l -= size;
+                _qsort_copy(def, dest, l);
+            } else {
+                r -= size;
+                _qsort_copy(def, dest, r);
             }
         }
+
+        _qsort_copy_n(def, lo, work, (size_t)(r - work) / size);
+    }
+}
+
+/**
+ * @brief Sort the n elements at base_ptr by merging their natural runs, if
+ *        there are few enough of them.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element
+ * @param n           number of elements
+ * @param work        room for n / 2 elements
+ * @param arg         context for less_r/compar_r
+ *
+ * @return non-zero if the elements were sorted.
+ */
+static gboing_always_inline gboing_flatten int
+_qsort_adaptive(const struct qsort_def *def, char *base_ptr, size_t n,
+                char *work, void *arg) {
+    const size_t size = def->size;
+    size_t ends[sizeof(size_t) * 8 + 1];
+    const size_t max_runs = _qsort_log2(n) + 1;
+    size_t runs = _qsort_find_runs(def, base_ptr, n, ends, max_runs, arg);
+
+    if (runs == 1)
+        return 1;
+
+    if (runs > max_runs)
+        return 0;
+
+    /* merge neighboring pairs of runs until only one is left */
+    while (runs > 1) {
+        size_t start = 0;
+        size_t merged = 0;
+        size_t i;
+
+        for (i = 0; i + 1 < runs; i += 2) {
+            _qsort_merge_runs(def, base_ptr + start * size, ends[i] - start,
+                              ends[i + 1] - ends[i], work, arg);
+            start = ends[merged++] = ends[i + 1];
+        }
+
+        if (i < runs)
+            ends[merged++] = ends[i];
+
+        runs = merged;
+    }
+
+    return 1;
+}
+
+#ifdef _QSORT_NET_BYTES
+
+/* In stage (k, j) of a bitonic sorting network, lane i is compared with lane
+ * i ^ j and keeps the lesser of the two when it's the lower lane of an
+ * ascending block of k lanes (or the upper lane of a descending one) and the
+ * greater otherwise. The final stages (k = lanes) are all ascending. */
+#define _QSORT_NET_PERM(i, k, j) ((i) ^ (j))
+#define _QSORT_NET_MIN(i, k, j)  (!((i) & (k)) == !((i) & (j)) ? -1 : 0)
+
+#define _QSORT_NET_LANES_4(f, k, j)                                         \
+    f(0, k, j), f(1, k, j), f(2, k, j), f(3, k, j)
+#define _QSORT_NET_LANES_8(f, k, j)                                         \
+    _QSORT_NET_LANES_4(f, k, j),                                            \
+    f(4, k, j), f(5, k, j), f(6, k, j), f(7, k, j)
+#define _QSORT_NET_LANES_16(f, k, j)                                        \
+    _QSORT_NET_LANES_8(f, k, j),                                            \
+    f(8, k, j), f(9, k, j), f(10, k, j), f(11, k, j),                       \
+    f(12, k, j), f(13, k, j), f(14, k, j), f(15, k, j)
+
+/* Each stage is spelled out with literal vector constants so that the
+ * permutes and masks don't depend upon gcc unrolling a loop. */
+#define _QSORT_NET_STAGE(t, lanes, k, j)                                    \
+    v = _qsort_net_stage_##t(v,                                             \
+        (_qsort_net_##t##_m){_QSORT_NET_LANES_##lanes(_QSORT_NET_PERM, k, j)},\
+        (_qsort_net_##t##_m){_QSORT_NET_LANES_##lanes(_QSORT_NET_MIN, k, j)});
+
+#define _QSORT_NET_STAGES_4(t, lanes)                                       \
+    _QSORT_NET_STAGE(t, lanes, 2, 1)                                        \
+    _QSORT_NET_STAGE(t, lanes, 4, 2)                                        \
+    _QSORT_NET_STAGE(t, lanes, 4, 1)
+#define _QSORT_NET_STAGES_8(t, lanes)                                       \
+    _QSORT_NET_STAGES_4(t, lanes)                                           \
+    _QSORT_NET_STAGE(t, lanes, 8, 4)                                        \
+    _QSORT_NET_STAGE(t, lanes, 8, 2)                                        \
+    _QSORT_NET_STAGE(t, lanes, 8, 1)
+#define _QSORT_NET_STAGES_16(t, lanes)                                      \
+    _QSORT_NET_STAGES_8(t, lanes)                                           \
+    _QSORT_NET_STAGE(t, lanes, 16, 8)                                       \
+    _QSORT_NET_STAGE(t, lanes, 16, 4)                                       \
+    _QSORT_NET_STAGE(t, lanes, 16, 2)                                       \
+    _QSORT_NET_STAGE(t, lanes, 16, 1)
+
+/* Defines the vector types, a network stage and a sort of up to lanes keys
+ * for one key type. Unused lanes are filled with sentinel (the greatest key)
+ * so that they sort to the end. Lanes only take their partner's key when it
+ * is strictly less (or greater), so that equal keys which differ in their
+ * representation (-0.0 and 0.0) are never duplicated. */
+#define _QSORT_NET_DEFINE(t, type, mask_type, lanes, sentinel)              \
+    __QSORT_NET_DEFINE(t, type, mask_type, lanes, sentinel)
+#define __QSORT_NET_DEFINE(t, type, mask_type, lanes, sentinel)             \
+typedef type _qsort_net_##t##_v                                             \
+        __attribute__((vector_size(_QSORT_NET_BYTES)));                     \
+typedef mask_type _qsort_net_##t##_m                                        \
+        __attribute__((vector_size(_QSORT_NET_BYTES)));                     \
+                                                                            \
+static gboing_always_inline _qsort_net_##t##_v                              \
+_qsort_net_stage_##t(_qsort_net_##t##_v v, _qsort_net_##t##_m perm,         \
+                     _qsort_net_##t##_m min) {                              \
+    const _qsort_net_##t##_v w = __builtin_shuffle(v, perm);                \
+    const _qsort_net_##t##_m take = ((_qsort_net_##t##_m)(w < v) & min)     \
+                                  | ((_qsort_net_##t##_m)(v < w) & ~min);   \
+                                                                            \
+    return (_qsort_net_##t##_v)(((_qsort_net_##t##_m)w & take)              \
+                              | ((_qsort_net_##t##_m)v & ~take));           \
+}                                                                           \
+                                                                            \
+static gboing_always_inline void                                            \
+_qsort_net_sort_##t(void *lo, size_t n) {                                   \
+    _qsort_net_##t##_v v;                                                   \
+    size_t i;                                                               \
+                                                                            \
+    for (i = 0; i < lanes; ++i)                                             \
+        v[i] = sentinel;                                                    \
+                                                                            \
+    memcpy(&v, lo, n * sizeof(type));                                       \
+    _QSORT_NET_STAGES_##lanes(t, lanes)                                     \
+    memcpy(lo, &v, n * sizeof(type));                                       \
+}
+
+_QSORT_NET_DEFINE(u32, uint32_t, int32_t, _QSORT_NET_LANES32, UINT32_MAX)
+_QSORT_NET_DEFINE(s32, int32_t,  int32_t, _QSORT_NET_LANES32, INT32_MAX)
+_QSORT_NET_DEFINE(f32, float,    int32_t, _QSORT_NET_LANES32, __builtin_inff())
+_QSORT_NET_DEFINE(u64, uint64_t, int64_t, _QSORT_NET_LANES64, UINT64_MAX)
+_QSORT_NET_DEFINE(s64, int64_t,  int64_t, _QSORT_NET_LANES64, INT64_MAX)
+_QSORT_NET_DEFINE(f64, double,   int64_t, _QSORT_NET_LANES64, __builtin_inf())
+
+#endif /* _QSORT_NET_BYTES */
+
+/**
+ * @brief Number of elements a sorting network can order for def, or zero if
+ *        sorting networks are not used (see qsort_def::key_kind).
+ */
+static gboing_always_inline size_t
+_qsort_net_lanes(const struct qsort_def *def) {
+#ifdef _QSORT_NET_BYTES
+    if (def->key_kind && !_qsort_is_indirect(def)
+            && (def->size == 4 || def->size == 8))
+        return _QSORT_NET_BYTES / def->size;
+#else
+    (void)def;
+#endif
+    return 0;
+}
+
+/**
+ * @brief Sort the elements lo through hi (inclusive) with a sorting network.
+ *
+ * There must be no more than _qsort_net_lanes() elements.
+ *
+ * @param def         the template parameters
+ * @param lo          leftmost element
+ * @param hi          rightmost element
+ */
+static gboing_always_inline void
+_qsort_net_sort(const struct qsort_def *def, char *lo, char *hi) {
+    const size_t n = (size_t)(hi - lo) / def->size + 1;
+
+    if (hi <= lo)
+        return;
+
+    assert(n <= _qsort_net_lanes(def));
+
+#ifdef _QSORT_NET_BYTES
+    if (def->size == 4) {
+        if (def->key_kind == QSORT_KEY_UNSIGNED)
+            _qsort_net_sort_u32(lo, n);
+        else if (def->key_kind == QSORT_KEY_SIGNED)
+            _qsort_net_sort_s32(lo, n);
+        else
+            _qsort_net_sort_f32(lo, n);
+    } else {
+        if (def->key_kind == QSORT_KEY_UNSIGNED)
+            _qsort_net_sort_u64(lo, n);
+        else if (def->key_kind == QSORT_KEY_SIGNED)
+            _qsort_net_sort_s64(lo, n);
+        else
+            _qsort_net_sort_f64(lo, n);
     }
+#else
+    gboing_assert_early(0);
+#endif
+}
+
+#ifdef _QSORT_VP_BYTES
+
+/* Vector partitioning primitives. Keys are loaded as integer vectors whatever
+ * their type and only reinterpreted to be compared. _qsort_vp_lt_*() returns a
+ * bitmask of the lanes of v that are less than the pivot in p.
+ * _qsort_vp_store*() stores those lanes (packed) at ls and the rest so that
+ * they end just before rs, returning the number of lanes stored at ls. Each
+ * may also overwrite up to a vector's worth of elements after ls and before
+ * rs. */
+# if _QSORT_VP_BYTES == 64
+
+typedef __m512i _qsort_vp_v;
+
+#  define _qsort_vp_load(p)         _mm512_loadu_si512(p)
+#  define _qsort_vp_set1_32(x)      _mm512_set1_epi32((int32_t)(x))
+#  define _qsort_vp_set1_64(x)      _mm512_set1_epi64((int64_t)(x))
+#  define _qsort_vp_lt_u32(v, p)    _mm512_cmplt_epu32_mask(v, p)
+#  define _qsort_vp_lt_s32(v, p)    _mm512_cmplt_epi32_mask(v, p)
+#  define _qsort_vp_lt_f32(v, p)                                            \
+    _mm512_cmp_ps_mask(_mm512_castsi512_ps(v), _mm512_castsi512_ps(p),      \
+                       _CMP_LT_OQ)
+#  define _qsort_vp_lt_u64(v, p)    _mm512_cmplt_epu64_mask(v, p)
+#  define _qsort_vp_lt_s64(v, p)    _mm512_cmplt_epi64_mask(v, p)
+#  define _qsort_vp_lt_f64(v, p)                                            \
+    _mm512_cmp_pd_mask(_mm512_castsi512_pd(v), _mm512_castsi512_pd(p),      \
+                       _CMP_LT_OQ)
+
+static gboing_always_inline size_t
+_qsort_vp_store32(void *ls, void *rs, _qsort_vp_v v, unsigned m) {
+    const size_t c = __builtin_popcount(m);
+
+    _mm512_mask_compressstoreu_epi32(ls, (__mmask16)m, v);
+    _mm512_mask_compressstoreu_epi32((uint32_t *)rs - (16 - c),
+                                     (__mmask16)~m, v);
+    return c;
+}
+
+static gboing_always_inline size_t
+_qsort_vp_store64(void *ls, void *rs, _qsort_vp_v v, unsigned m) {
+    const size_t c = __builtin_popcount(m);
+
+    _mm512_mask_compressstoreu_epi64(ls, (__mmask8)m, v);
+    _mm512_mask_compressstoreu_epi64((uint64_t *)rs - (8 - c),
+                                     (__mmask8)~m, v);
+    return c;
+}
+
+# else /* _QSORT_VP_BYTES == 32 */
+
+typedef __m256i _qsort_vp_v;
+
+#  define _qsort_vp_load(p)         _mm256_loadu_si256((const __m256i *)(p))
+#  define _qsort_vp_set1_32(x)      _mm256_set1_epi32((int32_t)(x))
+#  define _qsort_vp_set1_64(x)      _mm256_set1_epi64x((int64_t)(x))
+#  define _qsort_vp_lt_s32(v, p)                                            \
+    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(p, v)))
+#  define _qsort_vp_lt_u32(v, p)                                            \
+    _qsort_vp_lt_s32(_mm256_xor_si256(v, _mm256_set1_epi32(INT32_MIN)),     \
+                     _mm256_xor_si256(p, _mm256_set1_epi32(INT32_MIN)))
+#  define _qsort_vp_lt_f32(v, p)                                            \
+    _mm256_movemask_ps(_mm256_cmp_ps(_mm256_castsi256_ps(v),                \
+                                     _mm256_castsi256_ps(p), _CMP_LT_OQ))
+#  define _qsort_vp_lt_s64(v, p)                                            \
+    _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(p, v)))
+#  define _qsort_vp_lt_u64(v, p)                                            \
+    _qsort_vp_lt_s64(_mm256_xor_si256(v, _mm256_set1_epi64x(INT64_MIN)),    \
+                     _mm256_xor_si256(p, _mm256_set1_epi64x(INT64_MIN)))
+#  define _qsort_vp_lt_f64(v, p)                                            \
+    _mm256_movemask_pd(_mm256_cmp_pd(_mm256_castsi256_pd(v),                \
+                                     _mm256_castsi256_pd(p), _CMP_LT_OQ))
 
-    if (tmp_needed) {
-        if (d.free)
-            d.free(tmp_buffer);
+/**
+ * @brief Permute the 32-bit lanes of v selected by m to the bottom and the
+ *        rest to the top, each in their original order.
+ */
+static gboing_always_inline _qsort_vp_v
+_qsort_vp_compress(_qsort_vp_v v, unsigned m) {
+    const uint64_t identity = 0x0706050403020100ull;
+    const uint64_t bytes = _pdep_u64(m, 0x0101010101010101ull) * 0xff;
+    const unsigned c = __builtin_popcount(m);
+    uint64_t idx = _pext_u64(identity, bytes);
+
+    if (c < 8)
+        idx |= _pext_u64(identity, ~bytes) << (8 * c);
+
+    return _mm256_permutevar8x32_epi32(
+                v, _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((int64_t)idx)));
+}
+
+static gboing_always_inline size_t
+_qsort_vp_store32(void *ls, void *rs, _qsort_vp_v v, unsigned m) {
+    const _qsort_vp_v perm = _qsort_vp_compress(v, m);
+
+    _mm256_storeu_si256((__m256i *)rs - 1, perm);
+    _mm256_storeu_si256((__m256i *)ls, perm);
+    return __builtin_popcount(m);
+}
+
+static gboing_always_inline size_t
+_qsort_vp_store64(void *ls, void *rs, _qsort_vp_v v, unsigned m) {
+    /* each 64-bit lane is a pair of 32-bit lanes */
+    const unsigned m32 = _pdep_u32(m, 0x55) * 3;
+
+    return _qsort_vp_store32(ls, rs, v, m32) / 2;
+}
+
+# endif /* _QSORT_VP_BYTES == 32 */
+
+/* Defines the partition of the keys from first up to last about the pivot for
+ * one key type, returning the first key not less than the pivot.
+ *
+ * Whole vectors are partitioned in place: one is loaded from each end up front
+ * to make room, and each subsequent one is loaded from whichever end has the
+ * least room, so that there's always a vector's worth on both sides to store
+ * into (Bramas' scheme, as used in vqsort and x86-simd-sort). The last of the
+ * two vectors loaded up front fills the remaining room exactly. Leftover keys
+ * are partitioned one at a time. */
+#define _QSORT_VP_DEFINE(t, type, bits)                                     \
+static gboing_always_inline gboing_flatten char *                          \
+_qsort_vp_partition_##t(char *first, char *last, const void *pivot_ptr) {  \
+    const size_t lanes = _QSORT_VP_BYTES / sizeof(type);                    \
+    const size_t k = (size_t)(last - first) / sizeof(type) / lanes;         \
+    char *ls = first;                                                       \
+    char *p = first;                                                        \
+    type pivot;                                                             \
+                                                                            \
+    memcpy(&pivot, pivot_ptr, sizeof(pivot));                               \
+                                                                            \
+    if (k >= 2) {                                                           \
+        const size_t vsize = lanes * sizeof(type);                          \
+        uint##bits##_t pivot_bits;                                          \
+        _qsort_vp_v pv;                                                     \
+        char *l = first;                                                    \
+        char *r = first + k * vsize;                                        \
+        char *rs = r;                                                       \
+        const _qsort_vp_v vl = _qsort_vp_load(l);                           \
+        const _qsort_vp_v vr = _qsort_vp_load(r - vsize);                   \
+        size_t c;                                                           \
+                                                                            \
+        memcpy(&pivot_bits, pivot_ptr, sizeof(pivot_bits));                 \
+        pv = _qsort_vp_set1_##bits(pivot_bits);                             \
+        l += vsize;                                                         \
+        r -= vsize;                                                         \
+                                                                            \
+        while (l < r) {                                                     \
+            _qsort_vp_v v;                                                  \
+                                                                            \
+            if (l - ls <= rs - r) {                                         \
+                v = _qsort_vp_load(l);                                      \
+                l += vsize;                                                 \
+            } else {                                                        \
+                r -= vsize;                                                 \
+                v = _qsort_vp_load(r);                                      \
+            }                                                               \
+                                                                            \
+            c = _qsort_vp_store##bits(ls, rs, v, _qsort_vp_lt_##t(v, pv));  \
+            ls += c * sizeof(type);                                         \
+            rs -= (lanes - c) * sizeof(type);                               \
+        }                                                                   \
+                                                                            \
+        c = _qsort_vp_store##bits(ls, rs, vl, _qsort_vp_lt_##t(vl, pv));    \
+        ls += c * sizeof(type);                                             \
+        rs -= (lanes - c) * sizeof(type);                                   \
+                                                                            \
+        assert(rs - ls == (ssize_t)vsize);                                  \
+        c = _qsort_vp_store##bits(ls, rs, vr, _qsort_vp_lt_##t(vr, pv));    \
+        ls += c * sizeof(type);                                             \
+        p = first + k * vsize;                                              \
+    }                                                                       \
+                                                                            \
+    for (; p < last; p += sizeof(type)) {                                   \
+        type x;                                                             \
+                                                                            \
+        memcpy(&x, p, sizeof(x));                                           \
+        if (x < pivot) {                                                    \
+            memcpy(p, ls, sizeof(x));                                       \
+            memcpy(ls, &x, sizeof(x));                                      \
+            ls += sizeof(type);                                             \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    return ls;                                                              \
+}
+
+_QSORT_VP_DEFINE(u32, uint32_t, 32)
+_QSORT_VP_DEFINE(s32, int32_t,  32)
+_QSORT_VP_DEFINE(f32, float,    32)
+_QSORT_VP_DEFINE(u64, uint64_t, 64)
+_QSORT_VP_DEFINE(s64, int64_t,  64)
+_QSORT_VP_DEFINE(f64, double,   64)
+
+#endif /* _QSORT_VP_BYTES */
+
+/**
+ * @brief Whether partitioning is done with vectors for def (see
+ *        qsort_def::key_kind).
+ */
+static gboing_always_inline int
+_qsort_vp_enabled(const struct qsort_def *def) {
+#ifdef _QSORT_VP_BYTES
+    return def->key_kind && !_qsort_is_indirect(def)
+           && (def->size == 4 || def->size == 8);
+#else
+    (void)def;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Partition elements lo through hi (inclusive) about the pivot at lo
+ *        using vectors.
+ *
+ * Has the same contract as _qsort_partition_block(): elements less than the
+ * pivot end up on its left and the rest on its right.
+ *
+ * @param def         the template parameters
+ * @param lo          leftmost element (the pivot)
+ * @param hi          rightmost element
+ *
+ * @return the final position of the pivot.
+ */
+static gboing_always_inline gboing_flatten char *
+_qsort_partition_vec(const struct qsort_def *def, char *lo, char *hi) {
+    char *first = lo + def->size;
+    char *ls = first;
+
+#ifdef _QSORT_VP_BYTES
+    char *last = hi + def->size;
+
+    if (def->size == 4) {
+        if (def->key_kind == QSORT_KEY_UNSIGNED)
+            ls = _qsort_vp_partition_u32(first, last, lo);
+        else if (def->key_kind == QSORT_KEY_SIGNED)
+            ls = _qsort_vp_partition_s32(first, last, lo);
+        else
+            ls = _qsort_vp_partition_f32(first, last, lo);
+    } else {
+        if (def->key_kind == QSORT_KEY_UNSIGNED)
+            ls = _qsort_vp_partition_u64(first, last, lo);
+        else if (def->key_kind == QSORT_KEY_SIGNED)
+            ls = _qsort_vp_partition_s64(first, last, lo);
         else
-            /* TODO: make sure this works when alignment of allocated buffer was
-             * performed */
-            gboing_aligned_free(tmp_buffer);
+            ls = _qsort_vp_partition_f64(first, last, lo);
     }
+#else
+    (void)hi;
+    gboing_assert_early(0);
+#endif
+
+    /* put the pivot between the two */
+    ls -= def->size;
+    if (ls != lo)
+        _qsort_swap(def, lo, ls);
+
+    return ls;
+}
+
+/**
+ * @brief Fill in defaults for and restrict the optional fields of d, a copy of
+ *        the caller's struct qsort_def.
+ */
+static gboing_always_inline void
+_qsort_init_def(struct qsort_def *d) {
+    /* Restrict to reasonable value */
+    if (d->align > _QSORT_ALIGN_MAX)
+        d->align = _QSORT_ALIGN_MAX;
+
+    if (d->max_size_bits) {
+        d->max_size_bits = gboing_min(d->max_size_bits, sizeof(size_t) * 8);
+    } else
+        d->max_size_bits = sizeof(size_t) * 8 * 3 / 4;
+
+    if (!d->max_stack)
+        d->max_stack = 1024;
+
+//    if (d->align < GBOING_MIN_ALIGN)
+//        d->align = GBOING_MIN_ALIGN;
+
+#ifdef GNU_LIBC_SOME_SUCH
+    if (d->max_stack > __MAX_ALLOCA_CUTOFF)
+        d->max_stack = __MAX_ALLOCA_CUTOFF;
+#endif
+
+    d->index = NULL; /* ignore if it was populated by caller */
+    d->_prefixed = 0;
+
+    /* partitions left for a sorting network must fit in its vector */
+    if (_qsort_net_lanes(d) && (!d->max_thresh
+                                || d->max_thresh >= _qsort_net_lanes(d)))
+        d->max_thresh = _qsort_net_lanes(d) - 1;
+    else if (!d->max_thresh)
+        d->max_thresh = DEFAULT_MAX_THRESH;
+}
+
+/**
+ * @brief Workspace taken from a caller's buffer, the stack and the heap.
+ *
+ * Objects are placed in the first of these with room for them. Those that
+ * don't fit anywhere else are only given an offset into the heap block, which
+ * _qsort_ws_alloc() then allocates once for all of them.
+ */
+struct _qsort_ws {
+    char *buffer;           /* caller's buffer or NULL */
+    size_t buf_size;
+    size_t buf_used;
+    size_t stack_left;      /* bytes that may still go on the stack */
+    size_t tmp_needed;      /* size of the heap block */
+    size_t tmp_align;       /* alignment of the heap block */
+    void *tmp_buffer;       /* the heap block once allocated */
+};
+
+/**
+ * @brief Reserve space for an object at the end of a block.
+ *
+ * @param used        bytes of the block used so far, updated
+ * @param size        size of the object
+ * @param align       alignment of the object
+ *
+ * @return offset of the object in the block
+ */
+static gboing_always_inline size_t
+_qsort_ws_reserve(size_t *used, size_t size, size_t align) {
+    const size_t offset = (*used + align - 1) & ~(align - 1);
+
+    *used = offset + size;
+    return offset;
+}
+
+static gboing_always_inline void
+_qsort_ws_init(struct _qsort_ws *ws, void *buffer, size_t buf_size,
+               size_t max_stack) {
+    ws->buffer     = buffer;
+    ws->buf_size   = buffer ? buf_size : 0;
+    ws->buf_used   = 0;
+    ws->stack_left = max_stack;
+    ws->tmp_needed = 0;
+    ws->tmp_align  = 1;
+    ws->tmp_buffer = NULL;
+}
+
+/**
+ * @brief Place an object in the caller's buffer if it fits, otherwise reserve
+ *        space for it on the heap. The buffer must be aligned for every object
+ *        placed in it.
+ *
+ * @return a pointer into the buffer or NULL if the object goes on the heap, in
+ *         which case its offset is stored in heap_offset.
+ */
+static gboing_always_inline void *
+_qsort_ws_place(struct _qsort_ws *ws, size_t size, size_t align,
+                size_t *heap_offset) {
+    size_t used = ws->buf_used;
+    const size_t offset = _qsort_ws_reserve(&used, size, align);
+
+    if (used <= ws->buf_size) {
+        ws->buf_used = used;
+        return ws->buffer + offset;
+    }
+
+    ws->tmp_align = gboing_max(ws->tmp_align, align);
+    *heap_offset = _qsort_ws_reserve(&ws->tmp_needed, size, align);
+    return NULL;
+}
+
+/**
+ * @def _qsort_ws_place_stack(ws, size, align, heap_offset)
+ * @brief As _qsort_ws_place(), but an object that doesn't fit in the buffer
+ *        goes on the caller's stack while it has room. A macro, so that the
+ *        alloca belongs to the caller's frame.
+ */
+#define _qsort_ws_place_stack(ws, size, align, heap_offset) ({          \
+    struct _qsort_ws *const _ws = (ws);                                 \
+    const size_t _size = (size);                                        \
+    const size_t _align = (align);                                      \
+    void *_p = NULL;                                                    \
+                                                                        \
+    if (((_ws->buf_used + _align - 1) & ~(_align - 1)) + _size          \
+            > _ws->buf_size && _size <= _ws->stack_left) {              \
+        _ws->stack_left -= _size;                                       \
+        _p = gboing_aligned_alloca(_align, _size);                      \
+    } else                                                              \
+        _p = _qsort_ws_place(_ws, _size, _align, (heap_offset));        \
+    _p;                                                                 \
+})
+
+/**
+ * @brief Allocate the heap block, if any objects were put there.
+ *
+ * @return zero on success or ENOMEM.
+ */
+static gboing_always_inline int
+_qsort_ws_alloc(struct _qsort_ws *ws,
+                void *(*alloc_fn)(size_t alignment, size_t size)) {
+    if (!ws->tmp_needed)
+        return 0;
+
+    if (!!alloc_fn)
+        ws->tmp_buffer = alloc_fn(ws->tmp_align, ws->tmp_needed);
+    else
+        ws->tmp_buffer = gboing_aligned_alloc(ws->tmp_align, ws->tmp_needed);
+
+    return ws->tmp_buffer ? 0 : ENOMEM;
+}
+
+/**
+ * @brief Pointer to the object at offset in the heap block.
+ */
+static gboing_always_inline void *
+_qsort_ws_heap(const struct _qsort_ws *ws, size_t offset) {
+    return (char *)ws->tmp_buffer + offset;
+}
+
+static gboing_always_inline void
+_qsort_ws_free(struct _qsort_ws *ws, void (*free_fn)(void *buffer)) {
+    if (!ws->tmp_buffer)
+        return;
+
+    if (!!free_fn)
+        free_fn(ws->tmp_buffer);
+    else
+        gboing_aligned_free(ws->tmp_buffer);
+}
+
+/**
+ * @brief Return whichever of a, b and c holds their median, without moving any.
+ */
+static gboing_always_inline char *
+_qsort_med3(const struct qsort_def *def, char *a, char *b, char *c, void *arg) {
+    if (_qsort_less(def, a, b, arg)) {
+        if (_qsort_less(def, b, c, arg))
+            return b;
+        return _qsort_less(def, a, c, arg) ? c : a;
+    }
+
+    if (_qsort_less(def, c, b, arg))
+        return b;
+    return _qsort_less(def, c, a, arg) ? c : a;
+}
+
+/**
+ * @brief Order the elements a, b and c in place.
+ */
+static gboing_always_inline void
+_qsort_sort3(const struct qsort_def *def, char *a, char *b, char *c,
+             void *arg) {
+    if (_qsort_less(def, b, a, arg))
+        _qsort_swap(def, a, b);
+
+    if (_qsort_less(def, c, b, arg)) {
+        _qsort_swap(def, b, c);
+
+        if (_qsort_less(def, b, a, arg))
+            _qsort_swap(def, a, b);
+    }
+}
+
+/**
+ * @brief Select a pivot for lo through hi (inclusive) as qsort_def::pivot
+ *        directs and move it to the middle element.
+ *
+ * The least and greatest of the elements sampled are moved to lo and hi, so
+ * that lo is no greater than the pivot and hi no less.
+ *
+ * @return the middle element.
+ */
+static gboing_always_inline char *
+_qsort_select_pivot(const struct qsort_def *def, char *lo, char *hi,
+                    void *arg) {
+    const size_t size = def->size;
+    const size_t n = (size_t)(hi - lo) / size + 1;
+    char *const mid = lo + size * ((n - 1) >> 1);
+    char *pivot;
+    char *least;
+    char *greatest;
+
+    if (def->pivot >= QSORT_PIVOT_SAMPLE && n > _QSORT_SAMPLE_THRESH) {
+        const size_t k = 2 * _qsort_log2(n) + 1;
+        const size_t stride = n / k * size;
+        char *const first = lo + (n / k >> 1) * size;
+        size_t i;
+
+        /* insertion sort the sample where it lies */
+        for (i = 1; i < k; ++i) {
+            char *p;
+
+            for (p = first + i * stride;
+                 p != first && _qsort_less(def, p, p - stride, arg);
+                 p -= stride)
+                _qsort_swap(def, p, p - stride);
+        }
+
+        pivot = first + (k >> 1) * stride;
+        least = first;
+        greatest = first + (k - 1) * stride;
+    } else if (def->pivot >= QSORT_PIVOT_NINTHER && n > _QSORT_NINTHER_THRESH) {
+        const size_t step = (n >> 3) * size;
+
+        /* order each triple, leaving its median in the middle */
+        _qsort_sort3(def, lo, lo + step, lo + 2 * step, arg);
+        _qsort_sort3(def, mid - step, mid, mid + step, arg);
+        _qsort_sort3(def, hi - 2 * step, hi - step, hi, arg);
+
+        pivot = _qsort_med3(def, lo + step, mid, hi - step, arg);
+
+        least = _qsort_less(def, mid - step, lo, arg) ? mid - step : lo;
+        if (_qsort_less(def, hi - 2 * step, least, arg))
+            least = hi - 2 * step;
+
+        greatest = _qsort_less(def, hi, mid + step, arg) ? mid + step : hi;
+        if (_qsort_less(def, greatest, lo + 2 * step, arg))
+            greatest = lo + 2 * step;
+    } else {
+        _qsort_sort3(def, lo, mid, hi, arg);
+        return mid;
+    }
+
+    /* neither least nor greatest is where the pivot is or goes */
+    if (pivot != mid)
+        _qsort_swap(def, pivot, mid);
+
+    if (least != lo)
+        _qsort_swap(def, least, lo);
+
+    if (greatest != hi)
+        _qsort_swap(def, greatest, hi);
+
+    return mid;
+}
+
+/**
+ * @brief Partition the elements lo through hi (inclusive) about a pivot
+ *        selected as qsort_def::pivot directs.
+ *
+ * On return, every element from lo through *right is no greater than every
+ * element from *left through hi and any between the two are in their final
+ * places.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element of the whole array
+ * @param lo          leftmost element
+ * @param hi          rightmost element
+ * @param left        receives the first element of the right partition
+ * @param right       receives the last element of the left partition
+ * @param arg         context for less_r/compar_r
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_partition(const struct qsort_def *def, char *base_ptr, char *lo,
+                 char *hi, char **left, char **right, void *arg) {
+    char *left_ptr;
+    char *right_ptr;
+
+    /* Select a pivot and move it to MID, with LO and HI left no
+       greater and no less than it. This lowers the probability of
+       picking a pathological pivot value and skips a comparison for
+       both the LEFT_PTR and RIGHT_PTR in the while loops. */
+
+    char *mid = _qsort_select_pivot(def, lo, hi, arg);
+
+    if (def->block_size || _qsort_vp_enabled(def)) {
+        char *pivot;
+
+        /* Move the pivot out of the way and partition the rest. The
+           element previously at LO is no greater than the pivot,
+           while HI is no less, which bounds both initial scans. */
+        _qsort_swap(def, mid, lo);
+
+        if (lo != base_ptr && !_qsort_less(def, lo - def->size, lo, arg)) {
+            /* The pivot equals its predecessor, so gather all of its
+               equals on the left and only keep sorting the rest. */
+            pivot = _qsort_partition_equal(def, lo, hi, arg);
+            right_ptr = lo;
+        } else {
+            if (_qsort_vp_enabled(def))
+                pivot = _qsort_partition_vec(def, lo, hi);
+            else
+                pivot = _qsort_partition_block(def, lo, hi, arg);
+
+            right_ptr = pivot == lo ? lo : pivot - def->size;
+        }
+
+        /* The pivot is in its final place, so exclude it from both
+           sub-partitions, taking care not to step past LO or HI. */
+        left_ptr  = pivot == hi ? hi : pivot + def->size;
+    } else if (def->three_way == QSORT_THREE_WAY_ALWAYS
+               || (def->three_way == QSORT_THREE_WAY_AUTO && lo != base_ptr
+                   && !_qsort_less(def, lo - def->size, mid, arg))) {
+        _qsort_swap(def, mid, lo);
+        _qsort_partition_3way(def, lo, hi, &left_ptr, &right_ptr, arg);
+    } else {
+        left_ptr  = lo + def->size;
+        right_ptr = hi - def->size;
+
+        /* Here's the famous ``collapse the walls'' section of qsort.
+           Gotta like those tight inner loops!  They are the main reason
+           that this algorithm runs much faster than others. */
+        do {
+          while (_qsort_less (def, (void *) left_ptr, (void *) mid, arg))
+            left_ptr += def->size;
+
+          while (_qsort_less (def, (void *) mid, (void *) right_ptr, arg))
+            right_ptr -= def->size;
+
+            if (left_ptr < right_ptr) {
+                _qsort_swap(def, left_ptr, right_ptr);
+
+                if (mid == left_ptr)
+                    mid = right_ptr;
+                else if (mid == right_ptr)
+                    mid = left_ptr;
+
+                left_ptr += def->size;
+                right_ptr -= def->size;
+            } else if (left_ptr == right_ptr) {
+                left_ptr += def->size;
+                right_ptr -= def->size;
+                break;
+            }
+        } while (left_ptr <= right_ptr);
+    }
+
+    *left = left_ptr;
+    *right = right_ptr;
+}
+
+/**
+ * @brief Number of stack nodes _qsort_core() needs for an array of up to
+ *        2^def->max_size_bits elements.
+ *
+ * With two pivots, up to two parts are pushed each time the part being sorted
+ * shrinks to a third, for 2 * log3(n) < 4 / 3 * log2(n) nodes.
+ */
+static gboing_always_inline size_t
+_qsort_stack_nodes(const struct qsort_def *def) {
+    if (def->dual_pivot)
+        return def->max_size_bits * 4 / 3 + 2;
+
+    return def->max_size_bits - def->max_thresh + 1;
+}
+
+/**
+ * @brief Size in bytes of the stack _qsort_core() needs.
+ */
+static gboing_always_inline size_t
+_qsort_stack_size(const struct qsort_def *def) {
+    return _qsort_stack_nodes(def) * (def->introsort
+                                      ? sizeof(_qsort_depth_node)
+                                      : sizeof(stack_node));
+}
+
+/**
+ * @brief Partition lo through hi (inclusive) about two pivots and pick the
+ *        part to continue with.
+ *
+ * The smallest of the parts that are too large to leave is continued with and
+ * the others are pushed. When there are none, the next part is popped instead.
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_dual_step(const struct qsort_def *def, stack_node **top, char **lo,
+                 char **hi, size_t *depth, void *arg) {
+    const size_t size = def->size;
+    const size_t max_thresh = def->max_thresh * size;    /* ct const */
+    char *first[3];
+    size_t bytes[3];
+    char *next = NULL;
+    size_t next_bytes = 0;
+    char *p1;
+    char *p2;
+    unsigned i;
+
+    _qsort_partition_dual(def, *lo, *hi, &p1, &p2, arg);
+
+    first[0] = *lo;
+    bytes[0] = (size_t)(p1 - *lo);
+    first[1] = p1 + size;
+    bytes[1] = _qsort_less(def, p1, p2, arg) ? (size_t)(p2 - p1) - size : 0;
+    first[2] = p2 + size;
+    bytes[2] = (size_t)(*hi - p2);
+
+    for (i = 0; i < 3; ++i) {
+        if (bytes[i] <= max_thresh + size) {
+            /* Leave it to insertion sort or sort it now. */
+            if (_qsort_net_lanes(def) && bytes[i])
+                _qsort_net_sort(def, first[i], first[i] + bytes[i] - size);
+        } else if (!next || bytes[i] < next_bytes) {
+            if (next)
+                _qsort_push(def, top, next, next + next_bytes - size, *depth);
+            next = first[i];
+            next_bytes = bytes[i];
+        } else
+            _qsort_push(def, top, first[i], first[i] + bytes[i] - size, *depth);
+    }
+
+    if (next) {
+        *lo = next;
+        *hi = next + next_bytes - size;
+    } else
+        _qsort_pop(def, top, lo, hi, depth);
+}
+
+/**
+ * @brief Sort n elements at base_ptr with quicksort, leaving partitions below
+ *        def->max_thresh elements to insertion sort (or a sorting network).
+ *
+ * def must already have been through _qsort_init_def() (and have its size,
+ * align and index switched to the index when sorting indirectly), and
+ * def->elem_buf must be set.
+ *
+ * @param def         the template parameters
+ * @param base_ptr    first element
+ * @param n           number of elements
+ * @param qstack      stack with room for _qsort_stack_nodes() nodes
+ * @param arg         context for less_r/compar_r
+ */
+static gboing_always_inline gboing_flatten void
+_qsort_core(const struct qsort_def *def, char *base_ptr, size_t n,
+            stack_node *qstack, void *arg) {
+    const size_t max_thresh = def->max_thresh * def->size; /* ct const */
+
+    /* ==== Merge sort ==== */
+    if (n > def->max_thresh) {
+        char *lo = base_ptr;
+        char *hi = &lo[def->size * (n - 1)];
+        stack_node *top = qstack;
+        size_t depth = 0;                                /* rt value */
+        const size_t depth_limit = def->introsort ? 2 * _qsort_log2(n) : 0;
+
+        _qsort_push(def, &top, NULL, NULL, 0);
+
+        while (qstack < top) {
+            char *left_ptr;
+            char *right_ptr;
+
+            /* Introsort: give up on partitioning once we're in too deep. */
+            if (def->introsort && depth > depth_limit) {
+                _qsort_heapsort(def, lo, hi, arg);
+                _qsort_pop(def, &top, &lo, &hi, &depth);
+                continue;
+            }
+
+            ++depth;
+
+            if (def->dual_pivot) {
+                _qsort_dual_step(def, &top, &lo, &hi, &depth, arg);
+                continue;
+            }
+
+            _qsort_partition(def, base_ptr, lo, hi, &left_ptr, &right_ptr, arg);
+
+            /* Set up pointers for next iteration.  First determine whether
+               left and right partitions are below the threshold size.  If so,
+               ignore one or both.  Otherwise, push the larger partition's
+               bounds on the stack and continue sorting the smaller one. */
+
+            if ((size_t)(right_ptr - lo) <= max_thresh) {
+                if (_qsort_net_lanes(def))
+                    _qsort_net_sort(def, lo, right_ptr);
+
+                if ((size_t)(hi - left_ptr) <= max_thresh) {
+                    /* Ignore both small partitions. */
+                    if (_qsort_net_lanes(def))
+                        _qsort_net_sort(def, left_ptr, hi);
+
+                    _qsort_pop(def, &top, &lo, &hi, &depth);
+                } else
+                    /* Ignore small left partition. */
+                    lo = left_ptr;
+            } else if ((size_t)(hi - left_ptr) <= max_thresh) {
+                /* Ignore small right partition. */
+                if (_qsort_net_lanes(def))
+                    _qsort_net_sort(def, left_ptr, hi);
+
+                hi = right_ptr;
+            } else if ((right_ptr - lo) > (hi - left_ptr)) {
+                /* Push larger left partition indices. */
+                _qsort_push(def, &top, lo, right_ptr, depth);
+                lo = left_ptr;
+            } else {
+                /* Push larger right partition indices. */
+                _qsort_push(def, &top, left_ptr, hi, depth);
+                hi = right_ptr;
+            }
+        }
+    }
+
+    /* ==== Insertion sort ==== */
+
+    /* Once the BASE_PTR array is partially sorted by the merge sort, the rest
+     * is completely sorted using insertion sort, since this is efficient
+     * for partitions below def->max_thresh size. BASE_PTR points to the
+     * beginning of the array to sort, and END_PTR points at the very last
+     * element in the array (*not* one beyond it!). When sorting networks are
+     * used, each small partition has already been sorted as it was
+     * discarded. */
+
+    if (!_qsort_net_lanes(def) && !!def->_unique)
+        *def->_unique = _qsort_insertion_unique(def, base_ptr, n, arg);
+    else if (!_qsort_net_lanes(def))
+        _qsort_insertion_sort(def, base_ptr, n, arg);
+    else if (n <= def->max_thresh)
+        _qsort_net_sort(def, base_ptr, &base_ptr[def->size * (n - 1)]);
+}
+
+/* Order size using qsort.  This implementation incorporates
+   four optimizations discussed in Sedgewick:
+
+   1. Non-recursive, using an explicit stack of pointer that store the
+      next array partition to sort.  To save time, this maximum amount
+      of space required to store an array of SIZE_MAX is allocated on the
+      stack.  Assuming a 32-bit integer for size_t, this needs
+      only 32 * sizeof(stack_node) == 256 bytes. For 64 bits, the default
+      max_size_bits of 48 needs 45 nodes, or 720 bytes (1080 bytes with
+      qsort_def::introsort, whose nodes also record their depth).
+
+   2. Chose the pivot element using a median-of-three decision tree.
+      This reduces the probability of selecting a bad pivot value and
+      eliminates certain extraneous comparisons.
+
+   3. Only qsorts TOTAL_ELEMS / def.max_thresh partitions, leaving
+      insertion sort to order the def.max_thresh items within each partition.
+      This is a big win, since insertion sort is faster for small, mostly
+      sorted array segments.
+
+   4. The larger of the two sub-partitions is always pushed onto the
+      stack first, with the algorithm then concentrating on the
+      smaller partition.  This *guarantees* no more than log (n)
+      stack size is needed (actually O(1) in this case)!
+
+   Optionally (qsort_def::introsort), the depth of each partition is
+   recorded alongside its bounds on the stack and partitions that exceed
+   2 * log2(n) levels are heapsorted, as in Musser's introsort.  */
+
+/**
+ * @breif
+ *
+ * @param def
+ *
+ * @param buffer
+ * (Optional) Temporary memory to use instead of allocating memory on the stack
+ * and/or heap. If supplied, it should be aligned to the greater of
+ * qsort_def::align or the __alignof__(void *) of a failed assertion / sigbus
+ * may result. If not used, a compile-time constant NULL value should be passed
+ * to reduce generated code.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise. Using a compile-time constant
+ * value will result in a small reduction in generated code size.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ */
+
+static gboing_always_inline gboing_flatten int
+qsort_template(const struct qsort_def *def, void *buffer, size_t buf_size,
+               void *const pbase, size_t n, void *arg) {
+    /* this copy of def will be mutated to manage indirect sorting if needed */
+    struct qsort_def d = *def;
+    char *base_ptr = (char *) pbase;
+    size_t max_thresh;                      /* ct const */
+
+    /* Use indirect sorting if size is large */
+    const int indirect              = _qsort_is_indirect(&d); /* ct const */
+    struct _qsort_ws ws;
+    stack_node *qstack              = 0;  /* rt value */
+    const size_t QSTACK_ALIGN       = gboing_alignof(stack_node);
+    const size_t PTR_ALIGN          = gboing_alignof(void *);
+    const size_t INDEX_ALIGN        = d.key_prefix
+                                      ? gboing_alignof(struct _qsort_prefixed)
+                                      : PTR_ALIGN;
+    const size_t INDEX_SIZE         = d.key_prefix
+                                      ? sizeof(struct _qsort_prefixed)
+                                      : sizeof(void *);
+    const size_t ELEM_BUF_SIZE      = _qsort_elem_buf_size(&d);
+    const size_t ELEM_BUF_ALIGN     = _qsort_elem_buf_align(&d);
+    size_t qstack_size;                   /* ct const */
+    size_t elem_buf_tmp_offset      = 0;  /* ct const */
+    size_t qstack_tmp_offset        = 0;  /* ct const */
+    size_t index_tmp_offset         = 0;  /* ct const */
+    char *work                      = NULL; /* rt value */
+    size_t work_tmp_offset          = 0;  /* rt value */
+
+
+    if (n == 0)
+        /* Avoid lossage with unsigned arithmetic below.  */
+        return 0;
+
+    _qsort_init_def(&d);
+
+    assert(n <= ((size_t)1 << d.max_size_bits) - 1);
+
+    /* validate required fields are constants */
+    gboing_assert_const(!d.less + !d.compar + !d.less_r + !d.compar_r);
+    gboing_assert_const(d.introsort);
+    gboing_assert_const(d.block_size);
+    gboing_assert_const(d.key_kind);
+    gboing_assert_const(d.adaptive);
+    gboing_assert_const(!d.key_prefix);
+    gboing_assert_const(d.pivot);
+    gboing_assert_const(d.three_way);
+    gboing_assert_const(d.dual_pivot);
+    gboing_assert_const(d.align);
+    gboing_assert_const(d.size);
+    gboing_assert_msg(!!d.less || !!d.compar || !!d.less_r || !!d.compar_r,
+                      "a less or compar function is required");
+
+    gboing_assert(gboing_is_pow2(def->align));
+
+#if __STDC_VERSION__ >= 201112L
+    gboing_assert(gboing_is_pow2(_Alignof(max_align_t)));
+#endif
+
+    gboing_assert_msg(!(d.align & (d.align - 1)),
+                      "align must be a power of two"); /* ??? */
+    gboing_assert_msg(!(d.size % d.align),
+                      "size must be a multiple of align");
+    gboing_assert_msg(d.key_kind >= 0 && d.key_kind <= QSORT_KEY_FLOAT,
+                      "invalid key_kind");
+
+    /* verify pbase is really aligned as advertised */
+    gboing_assert_early(!((uintptr_t)pbase & (d.align - 1)));
+
+    /* perform checks on buffer & buf_size */
+    gboing_assert_early(buffer || !buf_size);
+    gboing_assert_early(((uintptr_t)buffer
+                        % gboing_max(d.align, PTR_ALIGN)) == 0);
+
+
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+
+    /* Allocate and/or calculate memory requirements */
+    _qsort_ws_init(&ws, buffer, buf_size, d.max_stack);
+
+    /* ==== d.elem_buf ==== -- buffer, then stack, then heap */
+    if (!d.elem_buf)
+        d.elem_buf = _qsort_ws_place_stack(&ws, ELEM_BUF_SIZE, ELEM_BUF_ALIGN,
+                                           &elem_buf_tmp_offset);
+
+    /* a caller's elem_buf only promises qsort_def::size bytes */
+    else if (ELEM_BUF_SIZE > d.size
+             || ((uintptr_t)d.elem_buf & (ELEM_BUF_ALIGN - 1)))
+        return EINVAL;
+
+    /* ==== qsort node stack ==== -- buffer, then stack, then heap */
+    /* subtracting max_thresh needs to be tested & verified */
+    qstack_size = _qsort_stack_size(&d);
+    qstack = _qsort_ws_place_stack(&ws, qstack_size, QSTACK_ALIGN,
+                                   &qstack_tmp_offset);
+
+    /* ==== indirection buffer ==== -- never goes on stack */
+    if (indirect && _qsort_argsort_in_place(&d)) {
+        gboing_assert_early(!((uintptr_t)d._argsort_out & (PTR_ALIGN - 1)));
+        d.index = d._argsort_out;
+
+    } else if (indirect)
+        d.index = _qsort_ws_place(&ws, n * INDEX_SIZE, INDEX_ALIGN,
+                                  &index_tmp_offset);
+
+    /* ==== adaptive merge workspace ==== -- n / 2 elements (or index entries)
+     * from the buffer, then stack, then heap */
+    if (d.adaptive && n > d.max_thresh)
+        work = _qsort_ws_place_stack(&ws, n / 2 * (indirect ? INDEX_SIZE
+                                                             : d.size),
+                                     indirect ? INDEX_ALIGN : d.align,
+                                     &work_tmp_offset);
+
+    /* allocate if heap space needed */
+    if (_qsort_ws_alloc(&ws, d.aligned_alloc))
+        return ENOMEM;
+
+    if (!d.elem_buf)
+        d.elem_buf = _qsort_ws_heap(&ws, elem_buf_tmp_offset);
+
+    if (!qstack)
+        qstack = _qsort_ws_heap(&ws, qstack_tmp_offset);
+
+    if (indirect && !d.index)
+        d.index = _qsort_ws_heap(&ws, index_tmp_offset);
+
+    if (d.adaptive && n > d.max_thresh && !work)
+        work = _qsort_ws_heap(&ws, work_tmp_offset);
+
+    /* now as long as we haven't erred in any of our padding calculation, this
+     * should never cause bad code generation*/
+    d.elem_buf    = gboing_assume_aligned(d.elem_buf, ELEM_BUF_ALIGN);
+    qstack        = gboing_assume_aligned(qstack, QSTACK_ALIGN);
+    d.index       = gboing_assume_aligned(d.index, INDEX_ALIGN);
+
+    /* but just to be safe, let's verify it for now */
+    assert(!((uintptr_t)d.elem_buf % ELEM_BUF_ALIGN));
+    assert(!((uintptr_t)qstack % QSTACK_ALIGN));
+    assert(!((uintptr_t)d.index % INDEX_ALIGN));
+
+    /* if using indirection, we'll now swap out d.size and d.align */
+    if (indirect && !!d.key_prefix) {
+        struct _qsort_prefixed *entries = (void *)d.index;
+        size_t i;
+
+        d.size = sizeof(struct _qsort_prefixed);
+        d.align = INDEX_ALIGN;
+        d._prefixed = 1;
+
+        for (i = n; i--;) {
+            entries[i].prefix = d.key_prefix(base_ptr + i * def->size);
+            entries[i].ptr    = base_ptr + i * def->size;
+        }
+
+        base_ptr = (char *) d.index;
+
+    } else if (indirect) {
+        size_t i;
+
+        d.size = sizeof(void *);
+        d.align = PTR_ALIGN;
+
+        assert(!((uintptr_t)d.index & (d.align - 1)));
+
+        for (i = n; i--;)
+            d.index[i] = base_ptr + i * def->size;
+
+        base_ptr = (char *) d.index;
+
+    }
+
+    /* now that we have d.size figured out... */
+    max_thresh = d.max_thresh * d.size;
+
+    /* These locals should still be compile-time constants */
+    gboing_assert_const(indirect);
+    gboing_assert_const(max_thresh);
+    gboing_assert_const(QSTACK_ALIGN);
+    gboing_assert_const(PTR_ALIGN);
+    gboing_assert_const(INDEX_ALIGN);
+    gboing_assert_const(qstack_size);
+
+
+    /* the index must stay whole to be applied, so duplicates are left for
+     * sort_unique_template() to drop afterwards */
+    if (indirect)
+        d._unique = NULL;
+
+    if (!d.adaptive || n <= d.max_thresh
+            || !_qsort_adaptive(&d, base_ptr, n, work, arg))
+        _qsort_core(&d, base_ptr, n, qstack, arg);
+
+    /* if we used indirect sorting, now we have to re-arrange the array. */
+    if (indirect) {
+        void **index = d.index;
+
+        /* Pack the pointers to the front of the index. Each store lands at or
+         * before the entry it's read from, so ascending order is safe. */
+        if (d._prefixed) {
+            const struct _qsort_prefixed *entries = (void *)index;
+            size_t i;
+
+            for (i = 0; i < n; ++i)
+                index[i] = entries[i].ptr;
+        }
+
+        d.size     = def->size;
+        d.align    = def->align;
+        d.index    = NULL;
+        d._prefixed = 0;
+
+        if (d._argsort)
+            _qsort_argsort_store(&d, pbase, index, n);
+        else
+            _qsort_apply_index(&d, pbase, index, n);
+    }
+
+    _qsort_ws_free(&ws, d.free);
 
     return 0;
 }
@@ -0,0 +1,492 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Radix sort C metafunctions
+ *
+ * Radix sorts for elements with a fixed-width (8, 16, 32 or 64 bit) integral
+ * key, specialized by a struct radix_def in the same fashion as
+ * qsort_template() is by a struct qsort_def. radix_sort_template() is a stable
+ * out-of-place LSD radix sort, while radix_flag_sort_template() is an unstable
+ * in-place MSD radix sort for when memory is tight.
+ */
+
+#ifndef _RADIX_TEMPLATE_H_
+#define _RADIX_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+/* Number of bits sorted per pass. */
+#define _RADIX_DIGIT_BITS 8
+#define _RADIX_DIGITS     (1 << _RADIX_DIGIT_BITS)
+
+/**
+ * @struct radix_def
+ * @brief pseudo-template definition and params for radix_sort_template
+ * @var radix_def::size
+ * Element size
+ *
+ * @var radix_def::align
+ * Minimum alignment of elements
+ *
+ * @var radix_def::key_bits
+ * Width of the key in bits: 8, 16, 32 or 64.
+ *
+ * @var radix_def::key_signed
+ * Non-zero if the key is a two's complement signed integer.
+ *
+ * @var radix_def::key
+ * Pointer to an (ideally inline) function that returns the key of an element.
+ * Only the low radix_def::key_bits of the returned value are used, so a signed
+ * key may simply be returned (and sign-extended) as is.
+ *
+ * @var radix_def::elem_copy
+ * (Optional) Pointer to a function to copy an element. See qsort_def::elem_copy.
+ *
+ * @var radix_def::max_stack
+ * (Optional) The maximum number of bytes of workspace radix_flag_sort_template()
+ * may put on the stack. See qsort_def::max_stack.
+ *
+ * @var radix_def::max_thresh
+ * (Optional) Buckets of this many elements or fewer are finished with
+ * insertion sort by radix_flag_sort_template().
+ *
+ * @var radix_def::aligned_alloc
+ * @var radix_def::free
+ * (Optional) Functions to allocate and free workspace. See qsort_def.
+ */
+struct radix_def {
+    size_t size;
+    size_t align;
+    size_t key_bits;
+    int key_signed;
+    uint64_t (*key)(const void *elem);
+    void (*elem_copy)(void *dest, const void *src);
+    size_t max_stack;
+    size_t max_thresh;
+    void *(*aligned_alloc)(size_t alignment, size_t size);
+    void (*free)(void *buffer);
+};
+
+/* Default radix_def::max_thresh for radix_flag_sort_template(). */
+#define DEFAULT_RADIX_MAX_THRESH 16
+
+/**
+ * @brief Retrieve the key of an element mapped to an unsigned value of the
+ *        same order.
+ */
+static gboing_always_inline uint64_t
+_radix_key(const struct radix_def *def, const void *elem) {
+    uint64_t key = def->key(gboing_assume_aligned(elem, def->align));
+
+    if (def->key_bits < 64)
+        key &= ((uint64_t)1 << (def->key_bits & 63)) - 1;
+
+    if (def->key_signed)
+        key ^= (uint64_t)1 << (def->key_bits - 1);
+
+    return key;
+}
+
+#if GCC_VERSION < 40700
+
+/* fallback comparison of the keys of a struct radix_def passed as arg */
+static int
+_radix_compar_r(const void *a, const void *b, void *def) {
+    const uint64_t ka = _radix_key(def, a);
+    const uint64_t kb = _radix_key(def, b);
+
+    return (ka > kb) - (ka < kb);
+}
+
+/* fallback radix_sort_template function */
+static int
+radix_sort_template(const struct radix_def *def, void *buffer,
+                    size_t buf_size, void *const pbase, size_t n) {
+    qsort_r(pbase, n, def->size, _radix_compar_r, (void *)def);
+    return 0;
+}
+
+/* fallback radix_flag_sort_template function */
+static int
+radix_flag_sort_template(const struct radix_def *def, void *buffer,
+                         size_t buf_size, void *const pbase, size_t n) {
+    qsort_r(pbase, n, def->size, _radix_compar_r, (void *)def);
+    return 0;
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @brief Retrieve digit number digit (from least significant) of a key.
+ */
+static gboing_always_inline size_t
+_radix_digit(uint64_t key, size_t digit) {
+    return (size_t)(key >> (digit * _RADIX_DIGIT_BITS)) & (_RADIX_DIGITS - 1);
+}
+
+/**
+ * @brief Copy an element via _qsort_copy() and its aligned code paths.
+ */
+static gboing_always_inline void
+_radix_copy(const struct radix_def *def, void *dest, const void *src) {
+    const struct qsort_def qdef = {
+        .size      = def->size,
+        .align     = def->align,
+        .elem_copy = def->elem_copy,
+    };
+
+    _qsort_copy(&qdef, dest, src);
+}
+
+/**
+ * @brief Copy n elements via _qsort_copy_n().
+ */
+static gboing_always_inline void
+_radix_copy_n(const struct radix_def *def, void *dest, const void *src,
+              size_t n) {
+    const struct qsort_def qdef = {
+        .size      = def->size,
+        .align     = def->align,
+        .elem_copy = def->elem_copy,
+    };
+
+    _qsort_copy_n(&qdef, dest, src, n);
+}
+
+/**
+ * @breif Stable least significant digit radix sort specialized by a
+ *        struct radix_def.
+ *
+ * A single pass over the array builds the histograms of all digits, after
+ * which each digit is scattered between the array and a workspace of n
+ * elements. Digits for which every element has the same value are skipped.
+ *
+ * @param def
+ * The template parameters.
+ *
+ * @param buffer
+ * (Optional) Workspace to use instead of allocating it on the heap. It is only
+ * used if it is at least n * radix_def::size bytes and should be aligned to
+ * radix_def::align.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+radix_sort_template(const struct radix_def *def, void *buffer,
+                    size_t buf_size, void *const pbase, size_t n) {
+    const size_t size = def->size;
+    const size_t digits = def->key_bits / _RADIX_DIGIT_BITS;
+    const size_t bytes = n * size;
+    size_t count[sizeof(uint64_t)][_RADIX_DIGITS];
+    void *tmp_buffer = NULL;
+    char *const base = pbase;
+    char *const end = base + bytes;
+    char *src;
+    char *dest;
+    char *p;
+    size_t digit;
+
+    gboing_assert_const(def->size);
+    gboing_assert_const(def->align);
+    gboing_assert_const(def->key_bits);
+    gboing_assert_const(def->key_signed);
+    gboing_assert_const(!def->key);
+    gboing_assert_const(!def->elem_copy);
+    gboing_assert_msg(def->key_bits == 8 || def->key_bits == 16
+                      || def->key_bits == 32 || def->key_bits == 64,
+                      "key_bits must be 8, 16, 32 or 64");
+    gboing_assert_msg(!def->aligned_alloc || !!def->free,
+                      "aligned_alloc requires a free function");
+    gboing_assert_early(!((uintptr_t)pbase & (def->align - 1)));
+    gboing_assert_early(!((uintptr_t)buffer & (def->align - 1)));
+
+    if (n < 2)
+        return 0;
+
+    /* ==== Histogram of every digit in one pass ==== */
+    memset(count, 0, sizeof(count[0]) * digits);
+
+    for (p = base; p < end; p += size) {
+        const uint64_t key = _radix_key(def, p);
+
+        for (digit = 0; digit < digits; ++digit)
+            ++count[digit][_radix_digit(key, digit)];
+    }
+
+    /* ==== Workspace ==== */
+    if (buf_size >= bytes)
+        dest = buffer;
+    else {
+        if (!!def->aligned_alloc)
+            tmp_buffer = def->aligned_alloc(def->align, bytes);
+        else
+            tmp_buffer = gboing_aligned_alloc(def->align, bytes);
+
+        if (!tmp_buffer)
+            return ENOMEM;
+
+        dest = tmp_buffer;
+    }
+
+    /* ==== Scatter each digit ==== */
+    src = base;
+    for (digit = 0; digit < digits; ++digit) {
+        size_t *const c = count[digit];
+        size_t sum = 0;
+        size_t i;
+        char *tmp;
+
+        /* nothing to do if all elements have the same value for this digit */
+        if (c[_radix_digit(_radix_key(def, src), digit)] == n)
+            continue;
+
+        /* convert counts into offsets */
+        for (i = 0; i < _RADIX_DIGITS; ++i) {
+            const size_t t = c[i];
+            c[i] = sum;
+            sum += t;
+        }
+
+        for (p = src; p < src + bytes; p += size) {
+            const size_t d = _radix_digit(_radix_key(def, p), digit);
+            _radix_copy(def, dest + c[d]++ * size, p);
+        }
+
+        tmp = src;
+        src = dest;
+        dest = tmp;
+    }
+
+    if (src != base)
+        _radix_copy_n(def, base, src, n);
+
+    if (tmp_buffer) {
+        if (def->free)
+            def->free(tmp_buffer);
+        else
+            gboing_aligned_free(tmp_buffer);
+    }
+
+    return 0;
+}
+
+/* An unsorted bucket of radix_flag_sort_template(). */
+struct _radix_frame {
+    char *lo;
+    size_t n;
+    size_t digit;
+};
+
+/**
+ * @brief less_r function comparing the keys of a struct radix_def, which is
+ *        passed as the context argument.
+ */
+static gboing_always_inline int
+_radix_less_r(const void *a, const void *b, void *def) {
+    return _radix_key(def, a) < _radix_key(def, b);
+}
+
+/**
+ * @breif In-place most significant digit radix sort (American flag sort)
+ *        specialized by a struct radix_def.
+ *
+ * Each bucket is counted and then permuted in place by swapping every element
+ * directly into the next free slot of its bucket, after which each of the
+ * sub-buckets is sorted by the next digit. Buckets of radix_def::max_thresh
+ * elements or fewer are finished with the insertion sort of qsort_template().
+ * Pending buckets are kept on an explicit stack rather than by recursion, so
+ * extra memory is bounded by O(radix * depth), where depth is the number of
+ * digits in the key. This sort is not stable.
+ *
+ * @param def
+ * The template parameters.
+ *
+ * @param buffer
+ * (Optional) Workspace to use instead of the stack and/or heap. It is used if
+ * it can hold the element buffer, bucket counters and bucket stack (a few KiB
+ * per byte of key) and should be aligned to the greater of radix_def::align
+ * and __alignof__(void *).
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+radix_flag_sort_template(const struct radix_def *def, void *buffer,
+                         size_t buf_size, void *const pbase, size_t n) {
+    const size_t size = def->size;
+    const size_t digits = def->key_bits / _RADIX_DIGIT_BITS;
+    const size_t max_thresh = def->max_thresh
+                            ? def->max_thresh
+                            : DEFAULT_RADIX_MAX_THRESH;
+    const size_t max_stack = def->max_stack ? def->max_stack : 1024;
+    const size_t WORK_ALIGN = gboing_max(def->align,
+                                         gboing_alignof(struct _radix_frame));
+    /* elem_buf, then next & end counters, then the bucket stack */
+    const size_t counters_offset = (size + WORK_ALIGN - 1) & ~(WORK_ALIGN - 1);
+    const size_t stack_offset = counters_offset
+                              + 2 * _RADIX_DIGITS * sizeof(size_t);
+    const size_t work_size = stack_offset + sizeof(struct _radix_frame)
+                                          * digits * _RADIX_DIGITS;
+    struct qsort_def qdef = {
+        .size       = def->size,
+        .align      = def->align,
+        .less_r     = _radix_less_r,
+        .elem_copy  = def->elem_copy,
+        .max_thresh = max_thresh,
+    };
+    struct _qsort_ws ws;
+    size_t work_tmp_offset = 0;
+    char *work;
+    size_t *next;
+    size_t *end;
+    struct _radix_frame *stack;
+    struct _radix_frame *top;
+
+    gboing_assert_const(def->size);
+    gboing_assert_const(def->align);
+    gboing_assert_const(def->key_bits);
+    gboing_assert_const(def->key_signed);
+    gboing_assert_const(!def->key);
+    gboing_assert_const(!def->elem_copy);
+    gboing_assert_const(work_size);
+    gboing_assert_msg(def->key_bits == 8 || def->key_bits == 16
+                      || def->key_bits == 32 || def->key_bits == 64,
+                      "key_bits must be 8, 16, 32 or 64");
+    gboing_assert_msg(!def->aligned_alloc || !!def->free,
+                      "aligned_alloc requires a free function");
+    gboing_assert_early(!((uintptr_t)pbase & (def->align - 1)));
+    gboing_assert_early(!((uintptr_t)buffer & (WORK_ALIGN - 1)));
+
+    if (n < 2)
+        return 0;
+
+    /* ==== Workspace ==== -- buffer, then stack, then heap */
+    _qsort_ws_init(&ws, buffer, buf_size, max_stack);
+    work = _qsort_ws_place_stack(&ws, work_size, WORK_ALIGN, &work_tmp_offset);
+
+    if (_qsort_ws_alloc(&ws, def->aligned_alloc))
+        return ENOMEM;
+
+    if (!work)
+        work = _qsort_ws_heap(&ws, work_tmp_offset);
+
+    qdef.elem_buf = gboing_assume_aligned(work, def->align);
+    next  = (size_t *)(work + counters_offset);
+    end   = next + _RADIX_DIGITS;
+    stack = (struct _radix_frame *)(work + stack_offset);
+    top   = stack;
+
+    top->lo = pbase;
+    top->n = n;
+    top->digit = digits - 1;
+    ++top;
+
+    while (stack < top) {
+        char *lo;
+        size_t count;
+        size_t digit;
+        size_t b;
+        size_t sum;
+
+        --top;
+        lo = top->lo;
+        count = top->n;
+        digit = top->digit;
+
+        if (count <= max_thresh) {
+            _qsort_insertion_sort(&qdef, lo, count, (void *)def);
+            continue;
+        }
+
+        /* ==== Count bucket sizes ==== */
+        memset(end, 0, sizeof(*end) * _RADIX_DIGITS);
+        for (b = 0; b < count; ++b)
+            ++end[_radix_digit(_radix_key(def, lo + b * size), digit)];
+
+        /* skip a digit that is the same for the whole bucket */
+        if (end[_radix_digit(_radix_key(def, lo), digit)] == count) {
+            if (digit) {
+                top->digit = digit - 1;
+                ++top;
+            }
+            continue;
+        }
+
+        for (b = 0, sum = 0; b < _RADIX_DIGITS; ++b) {
+            next[b] = sum;
+            sum += end[b];
+            end[b] = sum;
+        }
+
+        /* ==== Permute each element into its bucket ==== */
+        for (b = 0; b < _RADIX_DIGITS; ++b) {
+            while (next[b] < end[b]) {
+                char *p = lo + next[b] * size;
+                size_t d = _radix_digit(_radix_key(def, p), digit);
+
+                while (d != b) {
+                    _qsort_swap(&qdef, p, lo + next[d]++ * size);
+                    d = _radix_digit(_radix_key(def, p), digit);
+                }
+
+                ++next[b];
+            }
+        }
+
+        /* ==== Queue the sub-buckets for the next digit ==== */
+        if (!digit)
+            continue;
+
+        for (b = 0, sum = 0; b < _RADIX_DIGITS; sum = end[b++]) {
+            const size_t bucket_n = end[b] - sum;
+
+            if (bucket_n < 2)
+                continue;
+
+            top->lo = lo + sum * size;
+            top->n = bucket_n;
+            top->digit = digit - 1;
+            ++top;
+        }
+    }
+
+    _qsort_ws_free(&ws, def->free);
+
+    return 0;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _RADIX_TEMPLATE_H_ */
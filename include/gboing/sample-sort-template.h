@@ -0,0 +1,828 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif A parallel in-place sample sort C metafunction
+ *
+ * qsort_template_mt() can't put more than one thread to work until the first
+ * few partitions are done, so the passes over the whole array that matter the
+ * most on large inputs are serial. sample_sort_template() instead splits the
+ * array into up to 256 buckets in a single parallel pass, in the manner of
+ * IPS4o (Axtmann, Witt, Ferizovic & Sanders):
+ *
+ *  1. A random sample is sorted and equidistant splitters are drawn from it
+ *     into an implicit binary search tree, so that an element's bucket is found
+ *     with log2(buckets) branch-free comparisons. Elements are classified four
+ *     at a time to give the CPU independent work.
+ *  2. Each thread classifies its own stripe of the array, collecting elements
+ *     in a small buffer block per bucket and writing full blocks back to the
+ *     front of its stripe.
+ *  3. Full blocks are moved to their buckets (whose boundaries are rounded to
+ *     blocks) by swapping them through two per-thread block buffers. Each
+ *     bucket has a read and a write pointer protected by its own mutex.
+ *  4. The partial blocks left over in the thread's buffers and the blocks that
+ *     overhang bucket boundaries are copied to the ends of their buckets.
+ *  5. The buckets are sorted in parallel exactly as qsort_template() would.
+ *
+ * Apart from the per-thread buffers (buckets * block bytes each), no memory
+ * proportional to n is used unless elements are large enough to be sorted
+ * indirectly. Only one level of buckets is made, so inputs with very few
+ * distinct keys may leave one thread sorting most of the array.
+ *
+ * As with qsort_template_mt(), the thread start routine must be instantiated
+ * by the caller:
+ *
+ * @code
+ * static void *my_worker(void *worker) {
+ *     return sample_sort_worker_template(&my_def, worker);
+ * }
+ *
+ * ret = sample_sort_template(&my_def, my_worker, 0, 0, p, n, NULL);
+ * @endcode
+ */
+
+#ifndef _SAMPLE_SORT_TEMPLATE_H_
+#define _SAMPLE_SORT_TEMPLATE_H_
+
+#include <gboing/qsort-mt-template.h>
+
+/* Arrays no larger than this are sorted with qsort_template(). */
+#ifndef SAMPLE_SORT_DEFAULT_CUTOFF
+# define SAMPLE_SORT_DEFAULT_CUTOFF 0x10000
+#endif
+
+/* Size of the blocks moved between buckets. */
+#ifndef SAMPLE_SORT_BLOCK_BYTES
+# define SAMPLE_SORT_BLOCK_BYTES 2048
+#endif
+
+#define _SSORT_MAX_LOG_BUCKETS  8
+#define _SSORT_OVERSAMPLING     16
+
+#if GCC_VERSION < 40700
+
+/* fallback sample_sort_worker_template function */
+static void *
+sample_sort_worker_template(const struct qsort_def *def, void *worker) {
+    return NULL;
+}
+
+/* fallback sample_sort_template function */
+static int
+sample_sort_template(const struct qsort_def *def, void *(*worker)(void *),
+                     unsigned nthreads, size_t cutoff, void *const pbase,
+                     size_t n, void *arg) {
+    return qsort_template(def, pbase, n, arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+struct sample_sort_pool;
+
+/* Per-thread state. Aligned to keep threads off each other's cache lines. */
+struct _ssort_thread {
+    char *bufs;                     /* one partial block per bucket */
+    size_t *buf_n;                  /* elements in each partial block */
+    size_t *hist;                   /* elements classified into each bucket */
+    char *swap[2];                  /* blocks in flight during permutation */
+    stack_node *qstack;             /* stack for _qsort_core() */
+    void *elem_buf;
+    size_t stripe_begin;            /* first block of stripe */
+    size_t stripe_full;             /* first empty block of stripe */
+    unsigned id;
+    struct sample_sort_pool *pool;
+    pthread_t thread;
+} gboing_aligned(64);
+
+struct sample_sort_pool {
+    struct _ssort_thread *threads;
+    unsigned nthreads;              /* final once gate is opened */
+    unsigned log_buckets;
+    size_t nbuckets;
+    size_t block;                   /* elements per block */
+    size_t nblocks;                 /* whole blocks in array */
+    size_t n;
+    char *base;                     /* array (or index) being sorted */
+    void **index;                   /* index when sorting indirectly */
+    char *tree;                     /* splitters, Eytzinger order from 1 */
+    size_t *bucket_start;           /* nbuckets + 1 element offsets */
+    size_t *first_block;            /* nbuckets + 1 block offsets */
+    size_t *write;                  /* next block to write per bucket */
+    size_t *read;                   /* end of unread blocks per bucket */
+    pthread_mutex_t *locks;         /* protect write & read per bucket */
+    char *overflow;                 /* block that would run off the array */
+    size_t overflow_bucket;         /* its bucket or SIZE_MAX */
+    char *spill;                    /* blocks' overhang past each bucket */
+    size_t *spill_n;
+    size_t next_bucket;             /* next bucket to sort (atomic) */
+    pthread_barrier_t barrier;
+    pthread_mutex_t gate_lock;
+    pthread_cond_t gate;
+    int open;
+    void *arg;
+};
+
+/**
+ * @brief Find the bucket of x by descending the splitter tree.
+ *
+ * Elements equal to a splitter go to the bucket on its right.
+ */
+static gboing_always_inline size_t
+_ssort_bucket(const struct qsort_def *def, const struct sample_sort_pool *pool,
+              void *x, void *arg) {
+    size_t j = 1;
+    unsigned l;
+
+    for (l = 0; l < pool->log_buckets; ++l)
+        j = 2 * j + !_qsort_less(def, x, pool->tree + j * def->size, arg);
+
+    return j - pool->nbuckets;
+}
+
+/**
+ * @brief Find the buckets of the four elements at p, interleaving the
+ *        descents so that their comparisons can execute in parallel.
+ */
+static gboing_always_inline void
+_ssort_bucket4(const struct qsort_def *def, const struct sample_sort_pool *pool,
+               char *p, size_t *b, void *arg) {
+    const size_t size = def->size;
+    char *const tree = pool->tree;
+    size_t j0 = 1, j1 = 1, j2 = 1, j3 = 1;
+    unsigned l;
+
+    for (l = 0; l < pool->log_buckets; ++l) {
+        j0 = 2 * j0 + !_qsort_less(def, p,            tree + j0 * size, arg);
+        j1 = 2 * j1 + !_qsort_less(def, p + size,     tree + j1 * size, arg);
+        j2 = 2 * j2 + !_qsort_less(def, p + 2 * size, tree + j2 * size, arg);
+        j3 = 2 * j3 + !_qsort_less(def, p + 3 * size, tree + j3 * size, arg);
+    }
+
+    b[0] = j0 - pool->nbuckets;
+    b[1] = j1 - pool->nbuckets;
+    b[2] = j2 - pool->nbuckets;
+    b[3] = j3 - pool->nbuckets;
+}
+
+/**
+ * @brief Add element x to the partial block of bucket b, writing the block to
+ *        *w when it fills.
+ */
+static gboing_always_inline void
+_ssort_buffer(const struct qsort_def *def, const struct sample_sort_pool *pool,
+              struct _ssort_thread *self, size_t b, const void *x, char **w) {
+    const size_t size = def->size;
+    const size_t block = pool->block;
+    char *const buf = self->bufs + b * block * size;
+
+    _qsort_copy(def, buf + self->buf_n[b] * size, x);
+    ++self->hist[b];
+
+    if (++self->buf_n[b] == block) {
+        _qsort_copy_n(def, *w, buf, block);
+        *w += block * size;
+        self->buf_n[b] = 0;
+    }
+}
+
+/**
+ * @brief Classify the thread's stripe, leaving it with full blocks at the
+ *        front and the remaining elements in the thread's partial blocks.
+ *
+ * A block is only written once a whole block's worth of elements has been
+ * read past it, so unread elements are never overwritten.
+ */
+static gboing_always_inline void
+_ssort_classify(const struct qsort_def *def, struct sample_sort_pool *pool,
+                struct _ssort_thread *self, size_t stripe_end, void *arg) {
+    const size_t size = def->size;
+    const size_t block = pool->block;
+    char *const begin = pool->base + self->stripe_begin * block * size;
+    char *const end = pool->base + stripe_end * size;
+    char *p = begin;
+    char *w = begin;
+
+    memset(self->buf_n, 0, sizeof(size_t) * pool->nbuckets);
+    memset(self->hist, 0, sizeof(size_t) * pool->nbuckets);
+
+    for (; p + 4 * size <= end; p += 4 * size) {
+        size_t b[4];
+
+        _ssort_bucket4(def, pool, p, b, arg);
+        _ssort_buffer(def, pool, self, b[0], p, &w);
+        _ssort_buffer(def, pool, self, b[1], p + size, &w);
+        _ssort_buffer(def, pool, self, b[2], p + 2 * size, &w);
+        _ssort_buffer(def, pool, self, b[3], p + 3 * size, &w);
+    }
+
+    for (; p < end; p += size)
+        _ssort_buffer(def, pool, self, _ssort_bucket(def, pool, p, arg), p,
+                      &w);
+
+    self->stripe_full = (size_t)(w - pool->base) / (block * size);
+}
+
+/**
+ * @brief Lay out the buckets from the threads' histograms.
+ */
+static gboing_always_inline void
+_ssort_layout(struct sample_sort_pool *pool) {
+    const size_t block = pool->block;
+    size_t b;
+
+    pool->bucket_start[0] = 0;
+    for (b = 0; b < pool->nbuckets; ++b) {
+        size_t count = 0;
+        unsigned t;
+
+        for (t = 0; t < pool->nthreads; ++t)
+            count += pool->threads[t].hist[b];
+
+        pool->bucket_start[b + 1] = pool->bucket_start[b] + count;
+    }
+
+    assert(pool->bucket_start[pool->nbuckets] == pool->n);
+
+    for (b = 0; b <= pool->nbuckets; ++b)
+        pool->first_block[b] = (pool->bucket_start[b] + block - 1) / block;
+}
+
+/**
+ * @brief Determine if block i held a full block after classification.
+ */
+static gboing_always_inline int
+_ssort_is_full(const struct sample_sort_pool *pool, size_t i) {
+    const unsigned nthreads = pool->nthreads;
+    unsigned t = (unsigned)(i * nthreads / pool->nblocks);
+
+    /* stripes are all within a block of nblocks / nthreads */
+    while (t && pool->threads[t].stripe_begin > i)
+        --t;
+    while (t + 1 < nthreads && pool->threads[t + 1].stripe_begin <= i)
+        ++t;
+
+    return i < pool->threads[t].stripe_full;
+}
+
+/**
+ * @brief Move the full blocks within bucket b's blocks to its front.
+ *
+ * Only buckets that straddle stripes have any gaps between full blocks.
+ */
+static gboing_always_inline void
+_ssort_gather(const struct qsort_def *def, struct sample_sort_pool *pool,
+              size_t b) {
+    const size_t bytes = pool->block * def->size;
+    size_t lo = pool->first_block[b];
+    size_t hi = gboing_min(pool->first_block[b + 1], pool->nblocks);
+
+    while (lo < hi) {
+        if (_ssort_is_full(pool, lo))
+            ++lo;
+        else if (!_ssort_is_full(pool, hi - 1))
+            --hi;
+        else
+            _qsort_copy_n(def, pool->base + lo++ * bytes,
+                          pool->base + --hi * bytes, pool->block);
+    }
+
+    pool->write[b] = pool->first_block[b];
+    pool->read[b] = lo;
+}
+
+/**
+ * @brief Move every full block to its bucket.
+ *
+ * A thread takes an unread block from the back of a bucket's full blocks
+ * into swap[0], then swaps it with the block at the write pointer of its own
+ * bucket until the write pointer lands on a block that has already been read
+ * (or was never full). The block copies are done under the bucket's lock so
+ * that a block is never written while it's being read.
+ */
+static gboing_always_inline void
+_ssort_permute(const struct qsort_def *def, struct sample_sort_pool *pool,
+               struct _ssort_thread *self, void *arg) {
+    const size_t bytes = pool->block * def->size;
+    const size_t nbuckets = pool->nbuckets;
+    const size_t primary = self->id * nbuckets / pool->nthreads;
+    char *held = self->swap[0];
+    char *next = self->swap[1];
+    size_t i;
+
+    for (i = 0; i < nbuckets; ) {
+        const size_t b = (primary + i) % nbuckets;
+        int taken = 0;
+
+        pthread_mutex_lock(&pool->locks[b]);
+        if (pool->read[b] > pool->write[b]) {
+            _qsort_copy_n(def, held, pool->base + --pool->read[b] * bytes,
+                          pool->block);
+            taken = 1;
+        }
+        pthread_mutex_unlock(&pool->locks[b]);
+
+        if (!taken) {
+            ++i;
+            continue;
+        }
+
+        for (;;) {
+            const size_t dest = _ssort_bucket(def, pool, held, arg);
+            size_t slot;
+            char *tmp;
+
+            pthread_mutex_lock(&pool->locks[dest]);
+            slot = pool->write[dest]++;
+
+            if (slot >= pool->read[dest]) {
+                if (slot < pool->nblocks)
+                    _qsort_copy_n(def, pool->base + slot * bytes, held,
+                                  pool->block);
+                else {
+                    /* only the block straddling the end of the array */
+                    _qsort_copy_n(def, pool->overflow, held, pool->block);
+                    pool->overflow_bucket = dest;
+                }
+                pthread_mutex_unlock(&pool->locks[dest]);
+                break;
+            }
+
+            _qsort_copy_n(def, next, pool->base + slot * bytes, pool->block);
+            _qsort_copy_n(def, pool->base + slot * bytes, held, pool->block);
+            pthread_mutex_unlock(&pool->locks[dest]);
+
+            tmp = held;
+            held = next;
+            next = tmp;
+        }
+    }
+}
+
+/**
+ * @brief Save the part of bucket b's last block that overhangs the bucket
+ *        before the next bucket's cleanup overwrites it.
+ */
+static gboing_always_inline void
+_ssort_save_spill(const struct qsort_def *def, struct sample_sort_pool *pool,
+                  size_t b) {
+    const size_t size = def->size;
+    const size_t end = pool->bucket_start[b + 1];
+    size_t written = pool->write[b] * pool->block;
+
+    if (pool->overflow_bucket == b)
+        written -= pool->block;
+
+    /* a bucket with no blocks may start in the last block of the array */
+    pool->spill_n[b] = pool->write[b] > pool->first_block[b] && written > end
+                     ? written - end
+                     : 0;
+    _qsort_copy_n(def, pool->spill + b * pool->block * size,
+                  pool->base + end * size, pool->spill_n[b]);
+}
+
+/**
+ * @brief Copy n elements from src into the next free places of a bucket:
+ *        first [*dest, head_end), then up to the bucket's end from tail.
+ */
+static gboing_always_inline void
+_ssort_fill(const struct qsort_def *def, const struct sample_sort_pool *pool,
+            size_t *dest, size_t head_end, size_t tail, const char *src,
+            size_t n) {
+    const size_t size = def->size;
+
+    while (n) {
+        size_t count;
+
+        if (*dest == head_end)
+            *dest = tail;
+
+        count = *dest < head_end ? gboing_min(n, head_end - *dest) : n;
+        _qsort_copy_n(def, pool->base + *dest * size, src, count);
+        *dest += count;
+        src += count * size;
+        n -= count;
+    }
+}
+
+/**
+ * @brief Fill the ends of bucket b, which aren't covered by whole blocks,
+ *        with its remaining elements.
+ */
+static gboing_always_inline void
+_ssort_cleanup(const struct qsort_def *def, struct sample_sort_pool *pool,
+               size_t b) {
+    const size_t size = def->size;
+    const size_t block = pool->block;
+    const size_t start = pool->bucket_start[b];
+    const size_t end = pool->bucket_start[b + 1];
+    const size_t head_end = gboing_min(pool->first_block[b] * block, end);
+    size_t written = pool->write[b] * block;
+    size_t dest = start;
+    unsigned t;
+
+    if (pool->overflow_bucket == b) {
+        written -= block;
+        _ssort_fill(def, pool, &dest, head_end, gboing_min(written, end),
+                    pool->overflow, block);
+    }
+
+    _ssort_fill(def, pool, &dest, head_end, gboing_min(written, end),
+                pool->spill + b * block * size, pool->spill_n[b]);
+
+    for (t = 0; t < pool->nthreads; ++t) {
+        const struct _ssort_thread *thread = &pool->threads[t];
+
+        _ssort_fill(def, pool, &dest, head_end, gboing_min(written, end),
+                    thread->bufs + b * block * size, thread->buf_n[b]);
+    }
+
+    assert(dest == end || (dest == head_end && written >= end));
+}
+
+/**
+ * @brief Body of a sample_sort_template() thread specialized by a struct
+ *        qsort_def.
+ *
+ * @param def
+ * The template parameters, which must be the same as those passed to
+ * sample_sort_template().
+ *
+ * @param worker
+ * The start routine's argument.
+ *
+ * @return NULL
+ */
+static gboing_always_inline gboing_flatten void *
+sample_sort_worker_template(const struct qsort_def *def, void *worker) {
+    struct _ssort_thread *self = worker;
+    struct sample_sort_pool *pool = self->pool;
+    struct qsort_def d = *def;
+    const int indirect = _qsort_is_indirect(&d); /* ct const */
+    void *const arg = pool->arg;
+    unsigned nthreads;
+    size_t stripe_end;
+    size_t b;
+
+    _qsort_init_def(&d);
+    d.elem_buf = gboing_assume_aligned(self->elem_buf,
+                                       _qsort_elem_buf_align(&d));
+
+    if (indirect) {
+        d.size  = sizeof(void *);
+        d.align = gboing_alignof(void *);
+        d.index = pool->index;
+    }
+
+    gboing_assert_const(indirect);
+    gboing_assert_const(d.size);
+
+    /* wait until we know how many threads were actually started */
+    pthread_mutex_lock(&pool->gate_lock);
+    while (!pool->open)
+        pthread_cond_wait(&pool->gate, &pool->gate_lock);
+    pthread_mutex_unlock(&pool->gate_lock);
+
+    nthreads = pool->nthreads;
+    self->stripe_begin = self->id * pool->nblocks / nthreads;
+    stripe_end = self->id + 1 == nthreads
+               ? pool->n
+               : (self->id + 1) * pool->nblocks / nthreads * pool->block;
+
+    _ssort_classify(&d, pool, self, stripe_end, arg);
+    pthread_barrier_wait(&pool->barrier);
+
+    if (!self->id)
+        _ssort_layout(pool);
+    pthread_barrier_wait(&pool->barrier);
+
+    for (b = self->id; b < pool->nbuckets; b += nthreads)
+        _ssort_gather(&d, pool, b);
+    pthread_barrier_wait(&pool->barrier);
+
+    _ssort_permute(&d, pool, self, arg);
+    pthread_barrier_wait(&pool->barrier);
+
+    for (b = self->id; b < pool->nbuckets; b += nthreads)
+        _ssort_save_spill(&d, pool, b);
+    pthread_barrier_wait(&pool->barrier);
+
+    for (b = self->id; b < pool->nbuckets; b += nthreads)
+        _ssort_cleanup(&d, pool, b);
+    pthread_barrier_wait(&pool->barrier);
+
+    while ((b = __atomic_fetch_add(&pool->next_bucket, 1, __ATOMIC_RELAXED))
+           < pool->nbuckets) {
+        const size_t start = pool->bucket_start[b];
+        const size_t count = pool->bucket_start[b + 1] - start;
+
+        if (count > 1)
+            _qsort_core(&d, pool->base + start * d.size, count, self->qstack,
+                        arg);
+    }
+
+    return NULL;
+}
+
+/**
+ * @breif Parallel in-place sample sort specialized by a struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored
+ * except qsort_def::key_prefix (an index, when used, holds only pointers) and
+ * qsort_def::adaptive (no runs are looked for before partitioning).
+ *
+ * @param worker
+ * Thread start routine that returns sample_sort_worker_template(def, arg).
+ *
+ * @param nthreads
+ * Number of threads to sort with, including the calling thread, or zero for
+ * one per online CPU.
+ *
+ * @param cutoff
+ * Arrays of no more than this many elements are sorted by calling
+ * qsort_template() directly, or zero for SAMPLE_SORT_DEFAULT_CUTOFF.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r() or qsort_def::compar_r()
+ * function.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+sample_sort_template(const struct qsort_def *def, void *(*worker)(void *),
+                     unsigned nthreads, size_t cutoff, void *const pbase,
+                     size_t n, void *arg) {
+    struct qsort_def d = *def;
+    const int indirect              = _qsort_is_indirect(&d); /* ct const */
+    const size_t PTR_ALIGN          = gboing_alignof(void *);
+    const size_t THREAD_ALIGN       = gboing_alignof(struct _ssort_thread);
+    struct sample_sort_pool pool;
+    size_t tmp_align;
+    size_t tmp_needed               = 0;
+    size_t qstack_size;
+    size_t threads_offset;
+    size_t blocks_offset;
+    size_t index_offset             = 0;
+    size_t tree_offset;
+    size_t starts_offset;
+    size_t firsts_offset;
+    size_t write_offset;
+    size_t read_offset;
+    size_t locks_offset;
+    size_t overflow_offset;
+    size_t spill_offset;
+    size_t spill_n_offset;
+    size_t bufs_offset;
+    size_t buf_n_offset;
+    size_t hist_offset;
+    size_t swap_offset;
+    size_t qstack_offset;
+    size_t elem_buf_offset;
+    size_t elem_buf_size;
+    size_t elem_buf_align;
+    size_t elem_align;
+    size_t thread_size;
+    size_t block_bytes;
+    size_t sample;
+    uint64_t seed;
+    void *tmp_buffer;
+    unsigned started;
+    size_t i;
+
+    if (!cutoff)
+        cutoff = SAMPLE_SORT_DEFAULT_CUTOFF;
+
+    if (!nthreads) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (unsigned)cpus : 1;
+    }
+
+    if (n <= cutoff || n < 4)
+        return qsort_template(def, NULL, 0, pbase, n, arg);
+
+    _qsort_init_def(&d);
+
+    assert(n <= ((size_t)1 << d.max_size_bits) - 1);
+    gboing_assert_msg(!d.aligned_alloc || !!d.free,
+                      "aligned_alloc requires a free function");
+
+    /* elem_buf also holds whole elements when the index is applied */
+    elem_buf_size  = _qsort_elem_buf_size(&d);
+    elem_buf_align = _qsort_elem_buf_align(&d);
+    elem_align     = d.align;
+
+    /* the elements being moved about are the index entries when indirect */
+    if (indirect) {
+        d.size  = sizeof(void *);
+        d.align = PTR_ALIGN;
+    }
+
+    pool.block = gboing_max(SAMPLE_SORT_BLOCK_BYTES / d.size, (size_t)1);
+    pool.nblocks = n / pool.block;
+    pool.n = n;
+
+    /* aim for buckets of several blocks each */
+    pool.log_buckets = _qsort_log2(gboing_max(n / (4 * pool.block),
+                                              (size_t)2));
+    if (pool.log_buckets > _SSORT_MAX_LOG_BUCKETS)
+        pool.log_buckets = _SSORT_MAX_LOG_BUCKETS;
+    pool.nbuckets = (size_t)1 << pool.log_buckets;
+    block_bytes = pool.block * d.size;
+    sample = gboing_min(pool.nbuckets * _SSORT_OVERSAMPLING, n / 2);
+
+    /* Lay out the threads and the shared bucket data, then each thread's
+     * partial blocks, histogram, swap blocks, qstack and elem_buf and finally
+     * the index, all in one allocation. */
+    qstack_size = _qsort_stack_size(&d);
+    tmp_align = gboing_max(THREAD_ALIGN, elem_buf_align);
+
+    threads_offset  = _qsort_ws_reserve(&tmp_needed, nthreads
+                                        * sizeof(struct _ssort_thread),
+                                        THREAD_ALIGN);
+    tree_offset     = _qsort_ws_reserve(&tmp_needed, d.size * pool.nbuckets,
+                                        d.align);
+    starts_offset   = _qsort_ws_reserve(&tmp_needed, sizeof(size_t)
+                                        * (pool.nbuckets + 1), sizeof(size_t));
+    firsts_offset   = _qsort_ws_reserve(&tmp_needed, sizeof(size_t)
+                                        * (pool.nbuckets + 1), sizeof(size_t));
+    write_offset    = _qsort_ws_reserve(&tmp_needed, sizeof(size_t)
+                                        * pool.nbuckets, sizeof(size_t));
+    read_offset     = _qsort_ws_reserve(&tmp_needed, sizeof(size_t)
+                                        * pool.nbuckets, sizeof(size_t));
+    spill_n_offset  = _qsort_ws_reserve(&tmp_needed, sizeof(size_t)
+                                        * pool.nbuckets, sizeof(size_t));
+    locks_offset    = _qsort_ws_reserve(&tmp_needed, sizeof(pthread_mutex_t)
+                                        * pool.nbuckets,
+                                        gboing_alignof(pthread_mutex_t));
+    overflow_offset = _qsort_ws_reserve(&tmp_needed, block_bytes, d.align);
+    spill_offset    = _qsort_ws_reserve(&tmp_needed, block_bytes
+                                        * pool.nbuckets, d.align);
+
+    thread_size = 0;
+    bufs_offset     = _qsort_ws_reserve(&thread_size, block_bytes
+                                        * pool.nbuckets, d.align);
+    swap_offset     = _qsort_ws_reserve(&thread_size, 2 * block_bytes, d.align);
+    buf_n_offset    = _qsort_ws_reserve(&thread_size, sizeof(size_t)
+                                        * pool.nbuckets, sizeof(size_t));
+    hist_offset     = _qsort_ws_reserve(&thread_size, sizeof(size_t)
+                                        * pool.nbuckets, sizeof(size_t));
+    qstack_offset   = _qsort_ws_reserve(&thread_size, qstack_size,
+                                        gboing_alignof(stack_node));
+    elem_buf_offset = _qsort_ws_reserve(&thread_size, elem_buf_size,
+                                        elem_buf_align);
+    thread_size     = _qsort_ws_reserve(&thread_size, 0, tmp_align);
+    blocks_offset   = _qsort_ws_reserve(&tmp_needed, thread_size * nthreads,
+                                        tmp_align);
+
+    if (indirect)
+        index_offset = _qsort_ws_reserve(&tmp_needed, sizeof(void *) * n,
+                                         PTR_ALIGN);
+
+    if (!!d.aligned_alloc)
+        tmp_buffer = d.aligned_alloc(tmp_align, tmp_needed);
+    else
+        tmp_buffer = gboing_aligned_alloc(tmp_align, tmp_needed);
+
+    if (!tmp_buffer)
+        return ENOMEM;
+
+    pool.threads = (struct _ssort_thread *)((char *)tmp_buffer
+                                            + threads_offset);
+    pool.nthreads = nthreads;
+    pool.tree = (char *)tmp_buffer + tree_offset;
+    pool.bucket_start = (size_t *)((char *)tmp_buffer + starts_offset);
+    pool.first_block = (size_t *)((char *)tmp_buffer + firsts_offset);
+    pool.write = (size_t *)((char *)tmp_buffer + write_offset);
+    pool.read = (size_t *)((char *)tmp_buffer + read_offset);
+    pool.locks = (pthread_mutex_t *)((char *)tmp_buffer + locks_offset);
+    pool.overflow = (char *)tmp_buffer + overflow_offset;
+    pool.overflow_bucket = SIZE_MAX;
+    pool.spill = (char *)tmp_buffer + spill_offset;
+    pool.spill_n = (size_t *)((char *)tmp_buffer + spill_n_offset);
+    pool.next_bucket = 0;
+    pool.open = 0;
+    pool.arg = arg;
+    pool.index = NULL;
+
+    for (i = 0; i < nthreads; ++i) {
+        struct _ssort_thread *t = &pool.threads[i];
+        char *mem = (char *)tmp_buffer + blocks_offset + thread_size * i;
+
+        t->bufs     = mem + bufs_offset;
+        t->swap[0]  = mem + swap_offset;
+        t->swap[1]  = mem + swap_offset + block_bytes;
+        t->buf_n    = (size_t *)(mem + buf_n_offset);
+        t->hist     = (size_t *)(mem + hist_offset);
+        t->qstack   = (stack_node *)(mem + qstack_offset);
+        t->elem_buf = mem + elem_buf_offset;
+        t->id       = i;
+        t->pool     = &pool;
+    }
+
+    /* if using indirection, sort pointers to the elements instead */
+    if (indirect) {
+        pool.index = (void **)((char *)tmp_buffer + index_offset);
+
+        for (i = 0; i < n; ++i)
+            pool.index[i] = (char *)pbase + i * def->size;
+
+        pool.base = (char *)pool.index;
+        d.index = pool.index;
+    } else
+        pool.base = (char *)pbase;
+
+    d.elem_buf = pool.threads[0].elem_buf;
+
+    /* Move a random sample to the front of the array, sort it and take every
+     * (sample / nbuckets)th element as a splitter. Splitter m of the sorted
+     * order lands on the tree node whose in-order position is m. */
+    seed = 0x9e3779b97f4a7c15ull ^ n;
+    for (i = 0; i < sample; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        _qsort_swap(&d, pool.base + i * d.size,
+                    pool.base + (i + seed % (n - i)) * d.size);
+    }
+
+    _qsort_core(&d, pool.base, sample, pool.threads[0].qstack, arg);
+
+    for (i = 1; i < pool.nbuckets; ++i) {
+        const unsigned level = _qsort_log2(i);
+        const size_t leaf = ((2 * (i - ((size_t)1 << level)) + 1)
+                             << (pool.log_buckets - 1 - level));
+
+        _qsort_copy(&d, pool.tree + i * d.size,
+                    pool.base + (leaf * sample / pool.nbuckets) * d.size);
+    }
+
+    for (i = 0; i < pool.nbuckets; ++i)
+        pthread_mutex_init(&pool.locks[i], NULL);
+    pthread_mutex_init(&pool.gate_lock, NULL);
+    pthread_cond_init(&pool.gate, NULL);
+
+    /* the calling thread is thread 0; the array is striped among the threads
+     * that could actually be started */
+    for (started = 1; started < nthreads; ++started)
+        if (pthread_create(&pool.threads[started].thread, NULL, worker,
+                           &pool.threads[started]))
+            break;
+
+    pthread_barrier_init(&pool.barrier, NULL, started);
+
+    pthread_mutex_lock(&pool.gate_lock);
+    pool.nthreads = started;
+    pool.open = 1;
+    pthread_cond_broadcast(&pool.gate);
+    pthread_mutex_unlock(&pool.gate_lock);
+
+    worker(&pool.threads[0]);
+
+    for (i = 1; i < started; ++i)
+        pthread_join(pool.threads[i].thread, NULL);
+
+    /* if we used indirect sorting, now we have to re-arrange the array. */
+    if (indirect) {
+        d.size  = def->size;
+        d.align = elem_align;
+        d.index = NULL;
+        _qsort_apply_index(&d, pbase, pool.index, n);
+    }
+
+    pthread_barrier_destroy(&pool.barrier);
+    pthread_cond_destroy(&pool.gate);
+    pthread_mutex_destroy(&pool.gate_lock);
+    for (i = 0; i < pool.nbuckets; ++i)
+        pthread_mutex_destroy(&pool.locks[i]);
+
+    if (d.free)
+        d.free(tmp_buffer);
+    else
+        gboing_aligned_free(tmp_buffer);
+
+    return 0;
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _SAMPLE_SORT_TEMPLATE_H_ */
@@ -0,0 +1,193 @@
+/* Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+ *
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @breif Sort-and-deduplicate C metafunctions
+ *
+ * sort_unique_template() sorts an array with qsort_template() and leaves one
+ * of each run of equal elements at its front (as C++'s sort followed by
+ * unique). sort_reduce_template() instead folds each duplicate into the
+ * element kept with a combine function, for group-by style aggregation.
+ *
+ * Rather than making another pass over the sorted array, the duplicates are
+ * dropped during qsort_template()'s final insertion sort pass, a few elements
+ * behind it (see _qsort_insertion_unique()). When there's no such pass (the
+ * elements are sorted indirectly, by sorting networks or by merging natural
+ * runs), they're dropped in a separate pass.
+ */
+
+#ifndef _SORT_UNIQUE_TEMPLATE_H_
+#define _SORT_UNIQUE_TEMPLATE_H_
+
+#include <gboing/qsort-template.h>
+
+#if GCC_VERSION < 40700
+
+/* fallback sort_reduce_template function -- sorts with the fallback
+ * qsort_template(), so def needs a compar function */
+static int
+sort_reduce_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, void *const pbase, size_t n,
+                     void (*combine)(void *dest, const void *src,
+                                     void *context),
+                     size_t *unique, void *arg) {
+    const size_t size = def->size;
+    char *const base_ptr = (char *)pbase;
+    char *last = base_ptr;
+    size_t i;
+
+    qsort_template(def, pbase, n, arg);
+
+    for (i = 1; i < n; ++i) {
+        char *const p = &base_ptr[i * size];
+        const int cmp = !!def->compar_r ? def->compar_r(last, p, arg)
+                                        : def->compar(last, p);
+
+        if (cmp < 0) {
+            last += size;
+            if (last != p)
+                memcpy(last, p, size);
+        } else if (!!combine)
+            combine(last, p, arg);
+    }
+
+    *unique = n ? (size_t)(last - base_ptr) / size + 1 : 0;
+
+    return 0;
+}
+
+/* fallback sort_unique_template function */
+static int
+sort_unique_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, void *const pbase, size_t n,
+                     size_t *unique, void *arg) {
+    return sort_reduce_template(def, buffer, buf_size, pbase, n, NULL, unique,
+                                arg);
+}
+
+#else /* GCC_VERSION >= 40700 */
+
+/**
+ * @brief Drop (or combine) the duplicates of a sorted array.
+ *
+ * @return the number of distinct elements, now at the front of the array.
+ */
+static gboing_always_inline gboing_flatten size_t
+_sort_unique_pass(const struct qsort_def *def, char *base_ptr, size_t n,
+                  void *arg) {
+    const size_t size = def->size;
+    char *last = base_ptr;
+    size_t i;
+
+    if (!n)
+        return 0;
+
+    for (i = 1; i < n; ++i) {
+        char *const p = &base_ptr[i * size];
+
+        if (_qsort_less(def, last, p, arg)) {
+            last += size;
+            if (last != p)
+                _qsort_copy(def, last, p);
+        } else if (!!def->_combine)
+            def->_combine(last, p, arg);
+    }
+
+    return (size_t)(last - base_ptr) / size + 1;
+}
+
+/**
+ * @breif Sort and reduce each run of equal elements to one, specialized by a
+ *        struct qsort_def.
+ *
+ * @param def
+ * The template parameters. All fields used by qsort_template() are honored.
+ *
+ * @param buffer
+ * (Optional) Temporary memory for qsort_template() to use.
+ *
+ * @param buf_size
+ * Size of buffer (if non-null), zero otherwise.
+ *
+ * @param pbase
+ * Element array.
+ *
+ * @param n
+ * Number of elements.
+ *
+ * @param combine
+ * (Optional) Called for each duplicate, in sorted order, with the element it
+ * equals that is kept (dest) and the duplicate (src), which is discarded
+ * afterwards. It must not change how dest sorts. The first of each run is
+ * kept, though which one that is is only defined if the sort is stable.
+ *
+ * @param unique
+ * Where to store the number of distinct elements, which are at the front of the
+ * array in sorted order. The rest of the array is left in no particular order.
+ *
+ * @param arg
+ * Contextual argument to pass to qsort_def::less_r(), qsort_def::compar_r()
+ * and combine.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+sort_reduce_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, void *const pbase, size_t n,
+                     void (*combine)(void *dest, const void *src,
+                                     void *context),
+                     size_t *unique, void *arg) {
+    struct qsort_def d = *def;
+    size_t count = SIZE_MAX;
+    int ret;
+
+    d._combine = combine;
+    d._unique = &count;
+
+    ret = qsort_template(&d, buffer, buf_size, pbase, n, arg);
+    if (ret)
+        return ret;
+
+    /* qsort_template() only counts them when it drops them itself */
+    if (count == SIZE_MAX) {
+        _qsort_init_def(&d);
+        count = _sort_unique_pass(&d, (char *)pbase, n, arg);
+    }
+
+    *unique = count;
+
+    return 0;
+}
+
+/**
+ * @breif Sort and drop duplicates, specialized by a struct qsort_def.
+ *
+ * As sort_reduce_template() without a combine function.
+ *
+ * @return zero on success or ENOMEM if workspace could not be allocated.
+ */
+static gboing_always_inline gboing_flatten int
+sort_unique_template(const struct qsort_def *def, void *buffer,
+                     size_t buf_size, void *const pbase, size_t n,
+                     size_t *unique, void *arg) {
+    return sort_reduce_template(def, buffer, buf_size, pbase, n, NULL, unique,
+                                arg);
+}
+
+#endif /* GCC_VERSION >= 40700 */
+#endif /* _SORT_UNIQUE_TEMPLATE_H_ */
@@ -0,0 +1,202 @@
+#!/bin/bash
+
+# Measures where sorting an index of pointers overtakes sorting elements in
+# place on this host, for each element alignment and for inline vs outlined
+# element copies, and writes the thresholds qsort_template() uses to
+# include/gboing/qsort-calibration.h when QSORT_USE_CALIBRATION is defined.
+
+GBOING_DIR="${GBOING_DIR-$(cd "$(dirname "$0")/.." && pwd)}"
+
+export CC="${CC-gcc}"
+CFLAGS="${CFLAGS--O2 -march=native}"
+
+# Indirect sorting is never attempted below this size, as the index entries
+# (up to twice pointer size) are swapped through qsort_def::elem_buf.
+typeset -i MIN_SIZE=16
+
+die() {
+    echo "ERROR: $*" >&2
+    exit 1
+}
+
+showUsage() {
+    local argv0="$1"
+
+    shift
+
+    if (($#)); then
+        echo "ERROR: $*"
+        echo
+    fi
+
+    echo "Usage: ${argv0} -h"
+    echo "       ${argv0} [-t <filename>] [-n <count>] [-i <count>] [-o <filename>]"
+    echo
+    echo "    -t <filename>  Test-specific cfg file to take qsort_elem_sizes,"
+    echo "                   qsort_alignments and qsort_outline_copy from"
+    echo "                   (defaults to scripts/qsort.conf.example)"
+    echo "    -n <count>     Number of elements to sort (default 4096)"
+    echo "    -i <count>     Iterations per measurement, best is kept (default 5)"
+    echo "    -o <filename>  Header to write (defaults to"
+    echo "                   include/gboing/qsort-calibration.h)"
+    echo "    -h             Show this usage information"
+    echo
+    echo "Environment"
+    echo "    CC             Compiler to calibrate with (default gcc)"
+    echo "    CFLAGS         Flags to calibrate with (default -O2 -march=native)"
+    echo
+    echo "Each combination is built twice, so this takes a while."
+    exit 2
+}
+
+# usage: measure <size> <align> <outlined> <thresh>
+# Prints the best time in nanoseconds with _QSORT_IND_THRESH forced to thresh.
+measure() {
+    local dir="${BUILD_DIR}/$1-$2-$3-$4"
+
+    mkdir -p "${dir}" || die
+    make -s -C "${dir}" -f "${GBOING_DIR}/scripts/Makefile" \
+         GBOING_DIR="${GBOING_DIR}" \
+         CFLAGS="${CFLAGS} -DELEM_SIZE=$1 -DALIGN_SIZE=$2 -DOUTLINE_COPY=$3 -D_QSORT_IND_THRESH=$4" \
+         qsort-calibrate > "${dir}/build.log" 2>&1 ||
+        die "build failed, see ${dir}/build.log"
+    "${dir}/qsort-calibrate" ${elemCount} ${iterations} || die "$1 $2 $3 $4 failed"
+}
+
+# usage: pickThresh <size direct indirect>...
+# Prints the threshold losing the least time relative to the faster of the two
+# at each size, i.e., the one that best splits direct wins from indirect wins.
+pickThresh() {
+    echo "$@" | awk -v min=$((MIN_SIZE - 1)) '{
+        for (i = 1; i <= NF; i += 3) {
+            size[++n] = $i; direct[n] = $(i + 1); indirect[n] = $(i + 2);
+        }
+        best = -1;
+        for (t = 0; t <= n; ++t) {
+            thresh = t ? size[t] : min;
+            loss = 0;
+            for (j = 1; j <= n; ++j) {
+                fast = direct[j] < indirect[j] ? direct[j] : indirect[j];
+                took = size[j] > thresh ? indirect[j] : direct[j];
+                loss += took / fast - 1;
+            }
+            if (best < 0 || loss < best) {
+                best = loss;
+                pick = thresh;
+            }
+        }
+        print pick;
+    }'
+}
+
+# usage: emitTable <macro> <align thresh>...
+emitTable() {
+    local macro="$1"
+    local -a pairs
+
+    shift
+    pairs=("$@")
+
+    echo "#define ${macro}(align) \\"
+    # largest alignment first, so each row covers those up to the next one
+    for ((i = ${#pairs[@]} - 2; i > 0; i -= 2)); do
+        echo "    ((align) >= ${pairs[i]} ? ${pairs[i + 1]} : \\"
+    done
+    echo -n "     ${pairs[1]}"
+    for ((i = ${#pairs[@]} - 2; i > 0; i -= 2)); do
+        echo -n ")"
+    done
+    echo
+}
+
+main() {
+    local confFile="${GBOING_DIR}/scripts/qsort.conf.example"
+    local outFile="${GBOING_DIR}/include/gboing/qsort-calibration.h"
+    local -a table0 table1
+    local arg outlined align size
+
+    typeset -i elemCount=4096
+    typeset -i iterations=5
+
+    while getopts "t:n:i:o:h" arg "$@"; do
+        case "${arg}" in
+            t) confFile="${OPTARG}" ;;
+            n) elemCount="${OPTARG}" ;;
+            i) iterations="${OPTARG}" ;;
+            o) outFile="${OPTARG}" ;;
+            ?|h) showUsage "$0" ;;
+        esac
+    done
+
+    shift $((OPTIND-1))
+    (($# == 0)) || showUsage "$0" "unexpected argument"
+    ((elemCount > 0 && iterations > 0)) || showUsage "$0" "bad count"
+
+    . "${confFile}" || die "failed to read ${confFile}"
+
+    # builds go in a directory of our own, removed once we're done with it
+    BUILD_DIR="$(mktemp -d -t qsort-calibrate.XXXXXX)" ||
+        die "failed to create a build directory"
+
+    for outlined in ${qsort_outline_copy}; do
+        local -a table=()
+
+        for align in $(echo ${qsort_alignments} | tr ' ' '\n' | sort -n); do
+            local -a results=()
+            local direct indirect thresh
+
+            for size in $(echo ${qsort_elem_sizes} | tr ' ' '\n' | sort -n); do
+                ((size >= MIN_SIZE && size % align == 0)) || continue
+
+                direct=$(measure ${size} ${align} ${outlined} __SIZE_MAX__) || exit 1
+                indirect=$(measure ${size} ${align} ${outlined} 0) || exit 1
+                echo "outlined=${outlined} align=${align} size=${size}:" \
+                     "direct ${direct} ns, indirect ${indirect} ns" >&2
+                results+=(${size} ${direct} ${indirect})
+            done
+
+            ((${#results[@]})) || continue
+            thresh=$(pickThresh "${results[@]}")
+            echo "outlined=${outlined} align=${align}: threshold ${thresh}" >&2
+            table+=(${align} ${thresh})
+        done
+
+        ((${#table[@]})) || die "no element size fits any alignment"
+
+        if ((outlined)); then
+            table1=("${table[@]}")
+        else
+            table0=("${table[@]}")
+        fi
+    done
+
+    # fill in whichever variant wasn't measured from the one that was
+    ((${#table0[@]})) || table0=("${table1[@]}")
+    ((${#table1[@]})) || table1=("${table0[@]}")
+
+    {
+        echo "/* Generated by scripts/calibrate_ind_thresh.sh -- do not edit."
+        echo " * host:   $(uname -nm)"
+        echo " * CC:     ${CC} ($("${CC}" -dumpversion))"
+        echo " * CFLAGS: ${CFLAGS}"
+        echo " * n:      ${elemCount}"
+        echo " */"
+        echo
+        echo "#ifndef _QSORT_CALIBRATION_H_"
+        echo "#define _QSORT_CALIBRATION_H_"
+        echo
+        emitTable _QSORT_CAL_INLINE "${table0[@]}"
+        echo
+        emitTable _QSORT_CAL_OUTLINED "${table1[@]}"
+        echo
+        echo "#define _QSORT_IND_THRESH_FOR(align, outlined) \\"
+        echo "    ((outlined) ? _QSORT_CAL_OUTLINED(align) : _QSORT_CAL_INLINE(align))"
+        echo
+        echo "#endif /* _QSORT_CALIBRATION_H_ */"
+    } > "${outFile}" || die "failed to write ${outFile}"
+
+    echo "wrote ${outFile}; define QSORT_USE_CALIBRATION to use it" >&2
+    rm -rf "${BUILD_DIR}"
+}
+
+main "$@"
@@ -0,0 +1,81 @@
+/*
+ * qsort-calibrate.c - times qsort_template() for one element size, alignment
+ *                     and copy variant. scripts/calibrate_ind_thresh.sh builds
+ *                     it with indirect sorting forced on and off to find where
+ *                     one overtakes the other.
+ * Copyright (C) 2026 The gboing contributors
+ * This file is part of gboing.
+
+ * gboing is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * gboing is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+
+ * You should have received a copy of the GNU Lesser Public License
+ * along with gboing.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qsort-common.h"
+
+#include <string.h>
+
+static gboing_noinline gboing_flatten int
+my_quicksort(void *p, size_t n) {
+    return qsort_template(&my_def, NULL, 0, p, n, NULL);
+}
+
+/* usage: qsort-calibrate [elem_count [iterations]]
+ *
+ * Prints the best time of iterations sorts of the same random data in
+ * nanoseconds. */
+int main(int argc, char *argv[]) {
+    const size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 4096;
+    const unsigned long iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 5;
+    const size_t data_size = n * (size_t)(ELEM_SIZE);
+    const struct timespec forever = {.tv_sec = (time_t)1 << 30};
+    struct timespec best = forever;
+    void *orig;
+    void *arr;
+    unsigned long i;
+
+    if (!n || !iterations)
+        fatal_error("bad argument");
+
+    orig = aligned_alloc(ALIGN_SIZE, data_size);
+    arr  = aligned_alloc(ALIGN_SIZE, data_size);
+    if (gboing_unlikely(!orig || !arr))
+        fatal_error("aligned_alloc");
+
+    randomize(orig, n, ELEM_SIZE, 1);
+
+    for (i = 0; i < iterations; ++i) {
+        struct timespec start;
+        struct timespec end;
+        struct timespec elapsed;
+
+        memcpy(arr, orig, data_size);
+
+        timespec_set(&start);
+        errno = my_quicksort(arr, n);
+        timespec_set(&end);
+
+        if (errno)
+            fatal_error("my_quicksort");
+
+        elapsed = timespec_subtract(end, start);
+        if (timespec_lt(&elapsed, &best))
+            best = elapsed;
+    }
+
+    printf("%lu\n", (unsigned long)best.tv_sec * 1000000000ul + best.tv_nsec);
+
+    free(arr);
+    free(orig);
+
+    return 0;
+}
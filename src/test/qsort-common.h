@@ -21,6 +21,7 @@
 #define _QSORT_COMMON_H
 
 #include "gboing/qsort-template.h"
+#include "gboing/radix-template.h"
 #include "test-common.h"
 
 #ifndef ELEM_SIZE
@@ -39,6 +40,11 @@
 # define LESS_FN compar_r
 #endif
 
+/* what my_less and my_less_r return for true: any non-zero value is valid */
+#ifndef LESS_TRUE
+# define LESS_TRUE 1
+#endif
+
 #ifndef OUTLINE_COPY
 # define OUTLINE_COPY 0
 #endif
@@ -59,6 +65,62 @@
 # define MAX_THRESH 0
 #endif
 
+#ifndef INTROSORT
+# define INTROSORT 0
+#endif
+
+#ifndef BLOCK_SIZE
+# define BLOCK_SIZE 0
+#endif
+
+/* qsort_template_mt() and sample_sort_template() thread count (zero for one
+ * per CPU) and cutoff */
+#ifndef THREADS
+# define THREADS 0
+#endif
+
+#ifndef MT_CUTOFF
+# define MT_CUTOFF 0
+#endif
+
+/* flag keys as plain integers to enable sorting networks and vector
+ * partitioning (only has an effect when ELEM_SIZE is 4 or 8, where the key is
+ * the entire element) */
+#ifndef NETWORK
+# define NETWORK 0
+#endif
+
+/* scan for natural runs before sorting */
+#ifndef ADAPTIVE
+# define ADAPTIVE 0
+#endif
+
+/* carry key prefixes in the index (only has an effect when sorting
+ * indirectly) */
+#ifndef PREFIX
+# define PREFIX 0
+#endif
+
+/* pivot selection (see qsort_def::pivot), zero for the default */
+#ifndef PIVOT
+# define PIVOT 0
+#endif
+
+/* three-way partitioning (see qsort_def::three_way), zero for none */
+#ifndef THREE_WAY
+# define THREE_WAY 0
+#endif
+
+/* partition about two pivots */
+#ifndef DUAL_PIVOT
+# define DUAL_PIVOT 0
+#endif
+
+/* children per node in heap-template.h's heaps, zero for the default */
+#ifndef HEAP_ARITY
+# define HEAP_ARITY 0
+#endif
+
 static const unsigned KEY_BITS =
     ELEM_SIZE >= 8 && ((ELEM_SIZE) % gboing_alignof(uint64_t)) == 0
     ? 64
@@ -102,22 +164,22 @@ static __always_inline int my_less(const void *a, const void *b) {
         case 8: {
             const key_type(8) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(8) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 16: {
             const key_type(16) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(16) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 32: {
             const key_type(32) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(32) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 64: {
             const key_type(64) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(64) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         default:
             gboing_assert(0);
@@ -142,22 +204,22 @@ static __always_inline int my_less_r(const void *a, const void *b, void *context
         case 8: {
             const key_type(8) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(8) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 16: {
             const key_type(16) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(16) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 32: {
             const key_type(32) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(32) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         case 64: {
             const key_type(64) *_a = __builtin_assume_aligned(a, ALIGN_SIZE);
             const key_type(64) *_b = __builtin_assume_aligned(b, ALIGN_SIZE);
-            return *_a < *_b;
+            return (*_a < *_b) * LESS_TRUE;
         }
         default:
             gboing_assert(0);
@@ -165,6 +227,29 @@ static __always_inline int my_less_r(const void *a, const void *b, void *context
     }
 }
 
+static __always_inline uint64_t my_key(const void *a) {
+    switch (KEY_BITS) {
+        case 8 : return *(const key_type(8) *) __builtin_assume_aligned(a, ALIGN_SIZE);
+        case 16: return *(const key_type(16) *)__builtin_assume_aligned(a, ALIGN_SIZE);
+        case 32: return *(const key_type(32) *)__builtin_assume_aligned(a, ALIGN_SIZE);
+        case 64: return *(const key_type(64) *)__builtin_assume_aligned(a, ALIGN_SIZE);
+        default:
+            gboing_assert(0);
+            return 0;
+    }
+}
+
+/* the key, biased so that it orders correctly as an unsigned value */
+static gboing_unused uint64_t my_key_prefix(const void *a) {
+    const uint64_t sign_bit = 1ull << (KEY_BITS - 1);
+    const uint64_t mask = KEY_BITS == 64 ? ~0ull : (1ull << KEY_BITS) - 1;
+
+    if ((key_type(8))-1 < 0)
+        return (my_key(a) ^ sign_bit) & mask;
+    else
+        return my_key(a);
+}
+
 static gboing_unused void randomize(void *p, size_t n, size_t size, unsigned int seed) {
     unsigned long *arr = p;
     const size_t LONG_BITS = sizeof(unsigned long) * 8;
@@ -202,14 +287,17 @@ void gboing_noinline my_elem_copy(void *dest, const void *src) {
            ELEM_SIZE);
 }
 
+/* Note that keys are read as key_type(KEY_BITS), so copying elements by
+ * struct size_type assignment would violate strict aliasing rules (which gcc's
+ * ipa-modref exploits), hence memcpy. */
 void gboing_noinline my_elem_swap(void *tmp, void *a, void *b) {
-    struct size_type *_tmp = gboing_assume_aligned(tmp, ALIGN_SIZE);
-    struct size_type *_a = gboing_assume_aligned(a, ALIGN_SIZE);
-    struct size_type *_b = gboing_assume_aligned(b, ALIGN_SIZE);
+    tmp = gboing_assume_aligned(tmp, ALIGN_SIZE);
+    a   = gboing_assume_aligned(a, ALIGN_SIZE);
+    b   = gboing_assume_aligned(b, ALIGN_SIZE);
 
-    *_tmp = *_a;
-    *_a   = *_b;
-    *_b   = *_tmp;
+    memcpy(tmp, a, ELEM_SIZE);
+    memcpy(a, b, ELEM_SIZE);
+    memcpy(b, tmp, ELEM_SIZE);
 }
 
 static const struct qsort_def my_def = {
@@ -227,11 +315,50 @@ static const struct qsort_def my_def = {
 #endif
 #if MAX_THRESH
     .max_thresh    = MAX_THRESH,
+#endif
+#if INTROSORT
+    .introsort     = INTROSORT,
+#endif
+#if BLOCK_SIZE
+    .block_size    = BLOCK_SIZE,
+#endif
+#if NETWORK
+    .key_kind      = (key_type(8))-1 < 0 ? QSORT_KEY_SIGNED
+                                         : QSORT_KEY_UNSIGNED,
+#endif
+#if ADAPTIVE
+    .adaptive      = ADAPTIVE,
+#endif
+#if PREFIX
+    .key_prefix    = my_key_prefix,
+#endif
+#if PIVOT
+    .pivot         = PIVOT,
+#endif
+#if THREE_WAY
+    .three_way     = THREE_WAY,
+#endif
+#if DUAL_PIVOT
+    .dual_pivot    = DUAL_PIVOT,
+#endif
+#if HEAP_ARITY
+    .heap_arity    = HEAP_ARITY,
 #endif
     //.buf_size  = 0x10000,
     //.buf_align = 32
 };
 
+static const struct radix_def my_radix_def = {
+    .size          = ELEM_SIZE,
+    .align         = ALIGN_SIZE,
+    .key_bits      = KEY_BITS,
+    .key_signed    = (key_type(8))-1 < 0,
+    .key           = my_key,
+#if OUTLINE_COPY
+    .elem_copy     = my_elem_copy,
+#endif
+};
+
 typedef int (*compar_t)(const void *, const void *, void *arg);
 typedef void (*sort_func_t)(void *p, size_t n, size_t size, compar_t compar, void *arg);
 
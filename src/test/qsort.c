@@ -34,6 +34,17 @@
 #include <unistd.h>
 
 #include "gboing/qsort-template.h"
+#include "gboing/msort-template.h"
+#include "gboing/qsort-mt-template.h"
+#include "gboing/sample-sort-template.h"
+#include "gboing/qselect-template.h"
+#include "gboing/heap-template.h"
+#include "gboing/bsearch-template.h"
+#include "gboing/merge-template.h"
+#include "gboing/sort-unique-template.h"
+#include "gboing/qsort-soa-template.h"
+#include "gboing/argsort-template.h"
+#include "gboing/ext-sort-template.h"
 
 /* GNU's mqsort implementation. We have to define _GNU_SOURCE prior to
  * including stddef.h and include their qsort.c in the project for this to
@@ -84,6 +95,61 @@ my_quicksort(void *p, size_t n, size_t elem_size, compar_t compar, void *arg) {
         fatal_error("qsort_template returned %d\n", ret);
 }
 
+static gboing_noinline gboing_flatten void *
+my_quicksort_mt_worker(void *worker) {
+    return qsort_mt_worker_template(&my_def, worker);
+}
+
+static gboing_noinline gboing_flatten void
+my_quicksort_mt(void *p, size_t n, size_t elem_size, compar_t compar,
+                void *arg) {
+    int ret = qsort_template_mt(&my_def, my_quicksort_mt_worker, THREADS,
+                                MT_CUTOFF, p, n, NULL);
+
+    if (ret)
+        fatal_error("qsort_template_mt returned %d\n", ret);
+}
+
+static gboing_noinline gboing_flatten void *
+my_sample_sort_worker(void *worker) {
+    return sample_sort_worker_template(&my_def, worker);
+}
+
+static gboing_noinline gboing_flatten void
+my_sample_sort(void *p, size_t n, size_t elem_size, compar_t compar,
+               void *arg) {
+    int ret = sample_sort_template(&my_def, my_sample_sort_worker, THREADS,
+                                   MT_CUTOFF, p, n, NULL);
+
+    if (ret)
+        fatal_error("sample_sort_template returned %d\n", ret);
+}
+
+static gboing_noinline gboing_flatten void
+my_mergesort(void *p, size_t n, size_t elem_size, compar_t compar, void *arg) {
+    int ret = msort_template(&my_def, NULL, 0, p, n, NULL);
+
+    if (ret)
+        fatal_error("msort_template returned %d\n", ret);
+}
+
+static gboing_noinline gboing_flatten void
+my_radix_sort(void *p, size_t n, size_t elem_size, compar_t compar, void *arg) {
+    int ret = radix_sort_template(&my_radix_def, NULL, 0, p, n);
+
+    if (ret)
+        fatal_error("radix_sort_template returned %d\n", ret);
+}
+
+static gboing_noinline gboing_flatten void
+my_radix_flag_sort(void *p, size_t n, size_t elem_size, compar_t compar,
+                   void *arg) {
+    int ret = radix_flag_sort_template(&my_radix_def, NULL, 0, p, n);
+
+    if (ret)
+        fatal_error("radix_flag_sort_template returned %d\n", ret);
+}
+
 static void dump_keys(void * const data[4], size_t n, const char *heading) {
     size_t i;
 
@@ -130,9 +196,1022 @@ static void dump_keys(void * const data[4], size_t n, const char *heading) {
     }
 }
 
+static int memcmp_r(const void *a, const void *b, void *elem_size) {
+    return memcmp(a, b, *(const size_t *)elem_size);
+}
+
+/* Verify that mine holds the same elements as orig in any order */
+static int is_permutation(const void *orig, const void *mine, size_t n,
+                          size_t elem_size) {
+    const size_t bytes = n * elem_size;
+    void *a, *b;
+    int ret;
+
+    a = malloc(bytes);
+    b = malloc(bytes);
+    if (!a || !b)
+        fatal_error("malloc failed");
+
+    memcpy(a, orig, bytes);
+    memcpy(b, mine, bytes);
+    qsort_r(a, n, elem_size, memcmp_r, &elem_size);
+    qsort_r(b, n, elem_size, memcmp_r, &elem_size);
+    ret = !memcmp(a, b, bytes);
+
+    free(a);
+    free(b);
+    return ret;
+}
+
+/* Elements whose keys compare equal may legitimately be ordered differently by
+ * different algorithms (e.g., when the key is smaller than the element). When
+ * results differ, verify that the keys of mine and theirs are the same in
+ * every position and that mine is a permutation of the original data. */
+static int equivalent_sort(const void *orig, const void *mine,
+                           const void *theirs, size_t n, size_t elem_size) {
+    const char *m = mine;
+    const char *t = theirs;
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+        if (my_compar_r(&m[i * elem_size], &t[i * elem_size], NULL))
+            return 0;
+
+    return is_permutation(orig, mine, n, elem_size);
+}
+
+/* Unless one of these options is set, my_quicksort partitions exactly as
+ * glibc's _quicksort does, so elements with equal keys must end up in the same
+ * order and the results must match byte for byte. */
+#define ORDER_MAY_DIFFER (INTROSORT || BLOCK_SIZE || NETWORK || ADAPTIVE     \
+                          || PREFIX || PIVOT || THREE_WAY || DUAL_PIVOT)
+
+/* Reverse the order of the n elements at p */
+static void reverse_elems(void *p, size_t n, size_t elem_size) {
+    char *lo = p;
+    char *hi = lo + (n - 1) * elem_size;
+    char tmp[elem_size];
+
+    for (; lo < hi; lo += elem_size, hi -= elem_size) {
+        memcpy(tmp, lo, elem_size);
+        memcpy(lo, hi, elem_size);
+        memcpy(hi, tmp, elem_size);
+    }
+}
+
+/* Sort presorted, reversed and two-run versions of the sorted data, which
+ * exercise qsort_def::adaptive's fast paths when it's set */
+static void validate_presorted(const void *orig, const void *sorted,
+                               void *scratch, size_t n, size_t elem_size) {
+    static const char *const desc[] = {"sorted", "reversed", "two-run"};
+    const size_t bytes = n * elem_size;
+    unsigned i;
+
+    for (i = 0; i < 3; ++i) {
+        memcpy(scratch, sorted, bytes);
+
+        if (i == 1)
+            reverse_elems(scratch, n, elem_size);
+        else if (i == 2)
+            reverse_elems((char *)scratch + n / 2 * elem_size, n - n / 2,
+                          elem_size);
+
+        my_quicksort(scratch, n, elem_size, NULL, NULL);
+
+        if (memcmp(scratch, sorted, bytes)
+                && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+            fatal_error("\nmy_quicksort produced bad result for %s input",
+                        desc[i]);
+    }
+}
+
+/* State of McIlroy's quicksort adversary ("A Killer Adversary for Quicksort"),
+ * which decides the order of elements only as they are compared */
+struct killer {
+    size_t *val;                /* value given to each element, or gas */
+    size_t nsolid;              /* next value to give */
+    size_t candidate;           /* likely pivot */
+    size_t ncmp;                /* comparisons made */
+};
+
+static const size_t KILLER_GAS = SIZE_MAX;
+
+static int killer_less(const void *a, const void *b, void *arg) {
+    struct killer *k = arg;
+    const size_t x = *(const size_t *)a;
+    const size_t y = *(const size_t *)b;
+
+    ++k->ncmp;
+
+    if (k->val[x] == KILLER_GAS && k->val[y] == KILLER_GAS)
+        k->val[x == k->candidate ? x : y] = k->nsolid++;
+
+    if (k->val[x] == KILLER_GAS)
+        k->candidate = x;
+    else if (k->val[y] == KILLER_GAS)
+        k->candidate = y;
+
+    return k->val[x] < k->val[y];
+}
+
+static const struct qsort_def killer_def = {
+    .size          = sizeof(size_t),
+    .align         = alignof(size_t),
+    .less_r        = killer_less,
+    .introsort     = 1,
+};
+
+/* Sort against the adversary, which drives every partition to its worst case,
+ * so that qsort_def::introsort must fall back to heapsort to finish in
+ * O(n log n) comparisons */
+static void validate_introsort(size_t n) {
+    struct killer k = {.val = malloc(n * sizeof(size_t))};
+    size_t *a = malloc(n * sizeof(size_t));
+    size_t log2n = 0;
+    size_t i;
+    int ret;
+
+    if (!k.val || !a)
+        fatal_error("malloc failed");
+
+    for (i = 0; i < n; ++i) {
+        a[i] = i;
+        k.val[i] = KILLER_GAS;
+    }
+
+    ret = qsort_template(&killer_def, NULL, 0, a, n, &k);
+    if (ret)
+        fatal_error("qsort_template returned %d\n", ret);
+
+    for (i = 1; i < n; ++i)
+        if (k.val[a[i]] < k.val[a[i - 1]])
+            fatal_error("\nintrosort produced bad result for killer input");
+
+    /* each element must still be there exactly once */
+    for (i = 0; i < n; ++i)
+        k.val[i] = 0;
+    for (i = 0; i < n; ++i)
+        if (a[i] >= n || k.val[a[i]]++)
+            fatal_error("\nintrosort lost elements of killer input");
+
+    while (n >> ++log2n)
+        ;
+
+    if (k.ncmp > 8 * n * log2n)
+        fatal_error("\nintrosort made %lu comparisons for killer input of %lu",
+                    k.ncmp, n);
+
+    free(a);
+    free(k.val);
+}
+
+static int pivot_less(const void *a, const void *b) {
+    return *(const size_t *)a < *(const size_t *)b;
+}
+
+/* _qsort_select_pivot() is called directly, so it needs its own elem_buf */
+static size_t pivot_buf;
+
+static const struct qsort_def pivot_def = {
+    .size          = sizeof(size_t),
+    .align         = alignof(size_t),
+    .less          = pivot_less,
+    .elem_buf      = &pivot_buf,
+    .pivot         = QSORT_PIVOT_SAMPLE,
+};
+
+static size_t median3(size_t a, size_t b, size_t c) {
+    if (a < b)
+        return b < c ? b : a < c ? c : a;
+    return c < b ? b : c < a ? c : a;
+}
+
+/* Check that _qsort_select_pivot() picks the median of three, the ninther or
+ * the sample median by partition size, and that it leaves elements no greater
+ * and no less than the pivot in the first and last places */
+static void validate_pivot(void) {
+    static const size_t sizes[] = {3, 100, 129, 1000, 16385, 50000};
+    size_t s;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        const size_t n = sizes[s];
+        const size_t mid = (n - 1) >> 1;
+        size_t *a = malloc(n * sizeof(size_t));
+        size_t *seen = calloc(n, sizeof(size_t));
+        size_t expected;
+        size_t i;
+
+        if (!a || !seen)
+            fatal_error("malloc failed");
+
+        /* a shuffled permutation of 0 .. n - 1 */
+        for (i = 0; i < n; ++i)
+            a[i] = i;
+        for (i = n - 1; i; --i) {
+            const size_t j = (size_t)random() % (i + 1);
+            const size_t t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+
+        if (n > _QSORT_SAMPLE_THRESH) {
+            const size_t k = 2 * _qsort_log2(n) + 1;
+            const size_t stride = n / k;
+            size_t *sample = malloc(k * sizeof(size_t));
+
+            if (!sample)
+                fatal_error("malloc failed");
+
+            for (i = 0; i < k; ++i) {
+                size_t j;
+
+                /* insertion sort the sample as it's gathered */
+                for (j = i; j && sample[j - 1] > a[(stride >> 1) + i * stride];
+                     --j)
+                    sample[j] = sample[j - 1];
+                sample[j] = a[(stride >> 1) + i * stride];
+            }
+            expected = sample[k >> 1];
+            free(sample);
+        } else if (n > _QSORT_NINTHER_THRESH) {
+            const size_t step = n >> 3;
+
+            expected = median3(median3(a[0], a[step], a[2 * step]),
+                               median3(a[mid - step], a[mid], a[mid + step]),
+                               median3(a[n - 1 - 2 * step], a[n - 1 - step],
+                                       a[n - 1]));
+        } else
+            expected = median3(a[0], a[mid], a[n - 1]);
+
+        if (_qsort_select_pivot(&pivot_def, (char *)a, (char *)&a[n - 1], NULL)
+                != (char *)&a[mid])
+            fatal_error("\n_qsort_select_pivot didn't return the middle");
+
+        if (a[mid] != expected)
+            fatal_error("\n_qsort_select_pivot chose %lu instead of %lu for %lu"
+                        " elements", a[mid], expected, n);
+
+        if (a[0] > a[mid] || a[n - 1] < a[mid])
+            fatal_error("\n_qsort_select_pivot left bad sentinels for %lu"
+                        " elements", n);
+
+        for (i = 0; i < n; ++i)
+            if (seen[a[i]]++)
+                fatal_error("\n_qsort_select_pivot lost elements");
+
+        free(seen);
+        free(a);
+    }
+}
+
+/* Sort a copy of the data with its keys reduced to three values, the sort of
+ * input qsort_def::three_way is for, and check it against _quicksort */
+static void validate_few_keys(const void *orig, void *few, void *mine,
+                              void *theirs, size_t n, size_t elem_size) {
+    const size_t bytes = n * elem_size;
+    char *p = few;
+    size_t i;
+
+    memcpy(few, orig, bytes);
+    for (i = 0; i < n; ++i, p += elem_size) {
+        const unsigned char key = (unsigned char)p[0] % 3;
+
+        memset(p, 0, KEY_BITS / 8);
+        p[0] = key;
+    }
+
+    memcpy(mine, few, bytes);
+    memcpy(theirs, few, bytes);
+    my_quicksort(mine, n, elem_size, NULL, NULL);
+    _quicksort(theirs, n, elem_size, my_compar_r, NULL);
+
+    if (memcmp(mine, theirs, bytes)
+            && !equivalent_sort(few, mine, theirs, n, elem_size))
+        fatal_error("\nmy_quicksort produced bad result for few keys");
+}
+
+/* Order pointers to elements by key, then by address, which is the order a
+ * stable sort must produce */
+static int compar_stable(const void *a, const void *b, void *context) {
+    const char *pa = *(const char *const *)a;
+    const char *pb = *(const char *const *)b;
+    const int ret = my_compar_r(pa, pb, context);
+
+    return ret ? ret : (pa > pb) - (pa < pb);
+}
+
+/* Sort a copy of the data with its keys reduced to sixteen values and each
+ * element tagged with its original position (as much of it as fits after the
+ * key) with the stable sorts, and check that they keep equal elements in
+ * their original order */
+static void validate_stable(const void *orig, void *few, void *mine,
+                            void *theirs, size_t n, size_t elem_size) {
+    static const char *const desc[] = {"my_mergesort", "my_radix_sort"};
+    const size_t bytes = n * elem_size;
+    const size_t key_bytes = KEY_BITS / 8;
+    const size_t tag_bytes = gboing_min(elem_size - key_bytes, sizeof(size_t));
+    const char **ptrs = malloc(n * sizeof(*ptrs));
+    char *p = few;
+    size_t i;
+    unsigned j;
+
+    if (!ptrs)
+        fatal_error("malloc failed");
+
+    memcpy(few, orig, bytes);
+    for (i = 0; i < n; ++i, p += elem_size) {
+        const unsigned char key = (unsigned char)p[0] % 16;
+
+        memset(p, 0, key_bytes);
+        p[0] = key;
+        memcpy(p + key_bytes, &i, tag_bytes);
+        ptrs[i] = p;
+    }
+
+    qsort_r(ptrs, n, sizeof(*ptrs), compar_stable, NULL);
+    for (i = 0; i < n; ++i)
+        memcpy((char *)theirs + i * elem_size, ptrs[i], elem_size);
+
+    for (j = 0; j < 2; ++j) {
+        memcpy(mine, few, bytes);
+
+        if (j == 0)
+            my_mergesort(mine, n, elem_size, NULL, NULL);
+        else
+            my_radix_sort(mine, n, elem_size, NULL, NULL);
+
+        if (memcmp(mine, theirs, bytes))
+            fatal_error("\n%s is not stable", desc[j]);
+    }
+
+    free(ptrs);
+}
+
+/* Check qselect_template() and partial_sort_template() against the sorted
+ * data for a few values of k */
+static void validate_select(const void *orig, const void *sorted,
+                            void *scratch, size_t n, size_t elem_size) {
+    const size_t ks[] = {0, n / 3, n / 2, n - 1};
+    const char *s = sorted;
+    char *p = scratch;
+    struct size_type elem_buf;
+    size_t i, j;
+
+    for (i = 0; i < sizeof(ks) / sizeof(*ks); ++i) {
+        const size_t k = ks[i];
+        int ret;
+
+        memcpy(scratch, orig, n * elem_size);
+        ret = qselect_template(&my_def, &elem_buf, sizeof(elem_buf), scratch, n,
+                               k, NULL);
+        if (ret)
+            fatal_error("qselect_template returned %d\n", ret);
+
+        if (my_compar_r(&p[k * elem_size], &s[k * elem_size], NULL))
+            fatal_error("\nqselect_template selected the wrong element");
+
+        for (j = 0; j < n; ++j) {
+            const int cmp = my_compar_r(&p[j * elem_size], &p[k * elem_size],
+                                        NULL);
+
+            if (j < k ? cmp > 0 : j > k && cmp < 0)
+                fatal_error("\nqselect_template misplaced element %lu", j);
+        }
+
+        if (!is_permutation(orig, scratch, n, elem_size))
+            fatal_error("\nqselect_template lost elements");
+
+        memcpy(scratch, orig, n * elem_size);
+        ret = partial_sort_template(&my_def, NULL, 0, scratch, n, k + 1, NULL);
+        if (ret)
+            fatal_error("partial_sort_template returned %d\n", ret);
+
+        for (j = 0; j <= k; ++j)
+            if (my_compar_r(&p[j * elem_size], &s[j * elem_size], NULL))
+                fatal_error("\npartial_sort_template misplaced element %lu", j);
+
+        if (!is_permutation(orig, scratch, n, elem_size))
+            fatal_error("\npartial_sort_template lost elements");
+    }
+}
+
+/* Check the heap functions by heapifying the data and popping it all, by
+ * pushing it one element at a time and popping it again and by keeping the
+ * smallest third with heap_replace_top_template() */
+static void validate_heap(const void *orig, const void *sorted,
+                          void *scratch, size_t n, size_t elem_size) {
+    const size_t k = n / 3 + 1;
+    const char *o = orig;
+    char *p = scratch;
+    struct qsort_def d = my_def;
+    size_t i;
+
+    d.elem_buf = aligned_alloc(ALIGN_SIZE, elem_size);
+    if (!d.elem_buf)
+        fatal_error("aligned_alloc");
+
+    memcpy(scratch, orig, n * elem_size);
+    heapify_template(&d, scratch, n, NULL);
+    for (i = n; i > 1; --i)
+        heap_pop_template(&d, scratch, i, NULL);
+
+    if (memcmp(scratch, sorted, n * elem_size)
+            && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+        fatal_error("\nheapify_template/heap_pop_template produced bad result");
+
+    memset(scratch, 0, n * elem_size);
+    for (i = 0; i < n; ++i) {
+        memcpy(&p[i * elem_size], &o[i * elem_size], elem_size);
+        heap_push_template(&d, scratch, i + 1, NULL);
+    }
+    for (i = n; i > 1; --i)
+        heap_pop_template(&d, scratch, i, NULL);
+
+    if (memcmp(scratch, sorted, n * elem_size)
+            && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+        fatal_error("\nheap_push_template/heap_pop_template produced bad "
+                    "result");
+
+    memcpy(scratch, orig, n * elem_size);
+    heapify_template(&d, scratch, k, NULL);
+    for (i = k; i < n; ++i)
+        if (my_compar_r(&p[i * elem_size], p, NULL) < 0)
+            heap_replace_top_template(&d, scratch, k, &p[i * elem_size], NULL);
+    for (i = k; i > 1; --i)
+        heap_pop_template(&d, scratch, i, NULL);
+
+    for (i = 0; i < k; ++i)
+        if (my_compar_r(&p[i * elem_size], &((const char *)sorted)[i * elem_size],
+                        NULL))
+            fatal_error("\nheap_replace_top_template misplaced element %lu", i);
+
+    free(d.elem_buf);
+}
+
+/* Look up every element in the sorted data with lower_bound_template() and
+ * bsearch_template(), and in an Eytzinger copy of it with their eytzinger_
+ * counterparts */
+static void validate_search(const void *orig, const void *sorted,
+                            void *scratch, size_t n, size_t elem_size) {
+    const char *o = orig;
+    const char *s = sorted;
+    const char *e = scratch;
+    size_t i;
+
+    eytzinger_template(&my_def, scratch, sorted, n);
+
+    for (i = 0; i < n; ++i) {
+        const char *key = &o[i * elem_size];
+        const size_t lb = lower_bound_template(&my_def, key, sorted, n, NULL);
+        const size_t elb = eytzinger_lower_bound_template(&my_def, key,
+                                                          scratch, n, NULL);
+        const char *found;
+
+        if (lb >= n || my_compar_r(&s[lb * elem_size], key, NULL)
+                || (lb && my_compar_r(&s[(lb - 1) * elem_size], key, NULL) >= 0))
+            fatal_error("\nlower_bound_template returned %lu", lb);
+
+        found = bsearch_template(&my_def, key, sorted, n, NULL);
+        if (found != &s[lb * elem_size])
+            fatal_error("\nbsearch_template returned the wrong element");
+
+        /* the same element, as the first of its key sorts first */
+        if (elb >= n || memcmp(&e[elb * elem_size], &s[lb * elem_size],
+                               elem_size))
+            fatal_error("\neytzinger_lower_bound_template returned %lu", elb);
+
+        found = eytzinger_bsearch_template(&my_def, key, scratch, n, NULL);
+        if (found != &e[elb * elem_size])
+            fatal_error("\neytzinger_bsearch_template returned the wrong "
+                        "element");
+    }
+
+    /* keys greater than all are at the end, i.e., the greatest key is beyond
+     * everything before its first occurrence */
+    i = lower_bound_template(&my_def, &s[(n - 1) * elem_size], sorted, n, NULL);
+    if (lower_bound_template(&my_def, &s[(n - 1) * elem_size], sorted, i, NULL)
+            != i)
+        fatal_error("\nlower_bound_template found a key beyond the last");
+}
+
+/* merge_out::flush function that appends each block to a buffer */
+static int append_block(const void *block, size_t n, void *context) {
+    char **dest = context;
+
+    memcpy(*dest, block, n * ELEM_SIZE);
+    *dest += n * ELEM_SIZE;
+
+    return 0;
+}
+
+/* Sort the halves of the data and merge them with merge_template(), then sort
+ * uneven quarters and merge them with merge_k_template() through a small block
+ * that's flushed to the result */
+static void validate_merge(const void *orig, const void *sorted,
+                           void *scratch, void *result, size_t n,
+                           size_t elem_size) {
+    const size_t bytes = n * elem_size;
+    const size_t cuts[] = {0, n / 8, n / 2, n / 2 + n / 3, n};
+    const size_t nruns = sizeof(cuts) / sizeof(*cuts) - 1;
+    char *const s = scratch;
+    char block[7 * ELEM_SIZE] gboing_aligned(ALIGN_SIZE);
+    char *dest = result;
+    struct merge_run runs[nruns];
+    struct merge_out out = {result, n, NULL, NULL};
+    size_t i;
+    int ret;
+
+    memcpy(scratch, orig, bytes);
+    my_quicksort(s, n / 2, elem_size, NULL, NULL);
+    my_quicksort(&s[n / 2 * elem_size], n - n / 2, elem_size, NULL, NULL);
+
+    ret = merge_template(&my_def, s, n / 2, &s[n / 2 * elem_size], n - n / 2,
+                         &out, NULL);
+    if (ret)
+        fatal_error("merge_template returned %d\n", ret);
+
+    if (memcmp(result, sorted, bytes)
+            && !equivalent_sort(orig, result, sorted, n, elem_size))
+        fatal_error("\nmerge_template produced bad result");
+
+    memcpy(scratch, orig, bytes);
+    for (i = 0; i < nruns; ++i) {
+        runs[i].base = &s[cuts[i] * elem_size];
+        runs[i].n = cuts[i + 1] - cuts[i];
+        my_quicksort((void *)runs[i].base, runs[i].n, elem_size, NULL, NULL);
+    }
+
+    out.buf = block;
+    out.n = sizeof(block) / elem_size;
+    out.flush = append_block;
+    out.context = &dest;
+
+    memset(result, 0, bytes);
+    ret = merge_k_template(&my_def, NULL, 0, runs, nruns, &out, NULL);
+    if (ret)
+        fatal_error("merge_k_template returned %d\n", ret);
+
+    if (dest != (char *)result + bytes
+            || (memcmp(result, sorted, bytes)
+                && !equivalent_sort(orig, result, sorted, n, elem_size)))
+        fatal_error("\nmerge_k_template produced bad result");
+}
+
+/* sort_reduce_template() combine function that counts the duplicates passed
+ * to it */
+static void count_dups(void *dest, const void *src, void *context) {
+    if (my_compar_r(dest, src, NULL))
+        fatal_error("\nsort_reduce_template combined unequal elements");
+
+    ++*(size_t *)context;
+}
+
+/* Run sort_unique_template() and sort_reduce_template() on a copy of the data
+ * with its keys reduced to sixteen values, and check the distinct keys kept
+ * against those of the sorted copy */
+static void validate_unique(const void *orig, void *few, void *mine,
+                            void *theirs, size_t n, size_t elem_size) {
+    const size_t bytes = n * elem_size;
+    const char *t = theirs;
+    char *m = mine;
+    char *p = few;
+    size_t unique;
+    size_t expect = 1;
+    size_t dups = 0;
+    size_t i;
+    int ret;
+
+    memcpy(few, orig, bytes);
+    for (i = 0; i < n; ++i, p += elem_size) {
+        const unsigned char key = (unsigned char)p[0] % 16;
+
+        memset(p, 0, KEY_BITS / 8);
+        p[0] = key;
+    }
+
+    memcpy(theirs, few, bytes);
+    _quicksort(theirs, n, elem_size, my_compar_r, NULL);
+
+    memcpy(mine, few, bytes);
+    ret = sort_unique_template(&my_def, NULL, 0, mine, n, &unique, NULL);
+    if (ret)
+        fatal_error("sort_unique_template returned %d\n", ret);
+
+    /* each distinct key of theirs must be next in mine */
+    if (my_compar_r(m, t, NULL))
+        fatal_error("\nsort_unique_template misplaced element 0");
+
+    for (i = 1; i < n; ++i) {
+        if (!my_compar_r(&t[(i - 1) * elem_size], &t[i * elem_size], NULL))
+            continue;
+
+        if (expect >= unique
+                || my_compar_r(&m[expect * elem_size], &t[i * elem_size], NULL))
+            fatal_error("\nsort_unique_template misplaced element %lu",
+                        expect);
+        ++expect;
+    }
+
+    if (unique != expect)
+        fatal_error("\nsort_unique_template found %lu distinct elements, not "
+                    "%lu", unique, expect);
+
+    memcpy(mine, few, bytes);
+    ret = sort_reduce_template(&my_def, NULL, 0, mine, n, count_dups, &unique,
+                               &dups);
+    if (ret)
+        fatal_error("sort_reduce_template returned %d\n", ret);
+
+    if (unique != expect || dups != n - expect)
+        fatal_error("\nsort_reduce_template kept %lu and combined %lu of %lu",
+                    unique, dups, n);
+}
+
+/* Sort a copy of the data with qsort_soa_template(), carrying each element's
+ * original position in columns of three different sizes, and check that every
+ * column still matches its key */
+static void validate_soa(const void *orig, const void *sorted, void *keys,
+                         size_t n, size_t elem_size) {
+    size_t *pos = malloc(n * sizeof(*pos));
+    uint16_t *pos16 = malloc(n * sizeof(*pos16));
+    unsigned char *pos24 = malloc(n * 3);
+    char *seen = calloc(n, 1);
+    const struct qsort_column columns[] = {
+        {pos,   sizeof(*pos)},
+        {pos16, sizeof(*pos16)},
+        {pos24, 3},
+    };
+    const char *k = keys;
+    size_t i;
+    int ret;
+
+    if (!pos || !pos16 || !pos24 || !seen)
+        fatal_error("malloc failed");
+
+    for (i = 0; i < n; ++i) {
+        pos[i] = i;
+        pos16[i] = (uint16_t)i;
+        memcpy(&pos24[i * 3], &i, 3);
+    }
+
+    memcpy(keys, orig, n * elem_size);
+    ret = qsort_soa_template(&my_def, NULL, 0, keys, n, columns, 3, NULL);
+    if (ret)
+        fatal_error("qsort_soa_template returned %d\n", ret);
+
+    if (memcmp(keys, sorted, n * elem_size)
+            && !equivalent_sort(orig, keys, sorted, n, elem_size))
+        fatal_error("\nqsort_soa_template produced a bad sort");
+
+    for (i = 0; i < n; ++i) {
+        const size_t j = pos[i];
+
+        if (j >= n || seen[j]
+                || memcmp(&k[i * elem_size], (const char *)orig + j * elem_size,
+                          elem_size)
+                || pos16[i] != (uint16_t)j
+                || memcmp(&pos24[i * 3], &j, 3))
+            fatal_error("\nqsort_soa_template misplaced column element %lu", i);
+        seen[j] = 1;
+    }
+
+    free(seen);
+    free(pos24);
+    free(pos16);
+    free(pos);
+}
+
+static int byte_less(const void *a, const void *b) {
+    return *(const uint8_t *)a < *(const uint8_t *)b;
+}
+
+static uint64_t byte_prefix(const void *a) {
+    return *(const uint8_t *)a;
+}
+
+/* 1-byte keys, whose index entries are larger than they are */
+static const struct qsort_def byte_def = {
+    .size          = 1,
+    .align         = 1,
+    .less          = byte_less,
+};
+
+static const struct qsort_def byte_prefix_def = {
+    .size          = 1,
+    .align         = 1,
+    .less          = byte_less,
+    .key_prefix    = byte_prefix,
+};
+
+/* Sort 1-byte keys with qsort_soa_template() given a buffer of one key,
+ * followed by canary bytes, and check the sort, the column and the canary */
+static gboing_always_inline void
+check_soa_small(const struct qsort_def *def, const uint8_t *orig,
+                uint8_t *keys, size_t *pos, char *seen, size_t n) {
+    alignas(max_align_t) unsigned char buf[32];
+    const struct qsort_column columns[] = {{pos, sizeof(*pos)}};
+    size_t i;
+    int ret;
+
+    memset(buf, 0xa5, sizeof(buf));
+    memcpy(keys, orig, n);
+    for (i = 0; i < n; ++i)
+        pos[i] = i;
+
+    ret = qsort_soa_template(def, buf, 1, keys, n, columns, 1, NULL);
+    if (ret)
+        fatal_error("qsort_soa_template returned %d\n", ret);
+
+    for (i = 1; i < sizeof(buf); ++i)
+        if (buf[i] != 0xa5)
+            fatal_error("\nqsort_soa_template overran a 1-byte elem_buf");
+
+    memset(seen, 0, n);
+    for (i = 0; i < n; ++i) {
+        if ((i && keys[i - 1] > keys[i]) || pos[i] >= n || seen[pos[i]]
+                || keys[i] != orig[pos[i]])
+            fatal_error("\nqsort_soa_template misplaced 1-byte key %lu", i);
+        seen[pos[i]] = 1;
+    }
+}
+
+/* Sort 1-byte keys with qsort_soa_template(), whose elem_buf must also hold an
+ * index entry, plain and prefixed */
+static void validate_soa_small(size_t n) {
+    uint8_t *orig = malloc(n);
+    uint8_t *keys = malloc(n);
+    size_t *pos = malloc(n * sizeof(*pos));
+    char *seen = malloc(n);
+    size_t i;
+
+    if (!orig || !keys || !pos || !seen)
+        fatal_error("malloc failed");
+
+    for (i = 0; i < n; ++i)
+        orig[i] = (uint8_t)(i * 7919 % 251);
+
+    check_soa_small(&byte_def, orig, keys, pos, seen, n);
+    check_soa_small(&byte_prefix_def, orig, keys, pos, seen, n);
+
+    free(seen);
+    free(pos);
+    free(keys);
+    free(orig);
+}
+
+/* Check that the elements of orig taken in the order of an argsort result are
+ * sorted and that each is taken once */
+static void check_argsort(const char *what, const void *orig,
+                          const void *sorted, void *scratch,
+                          const size_t *order, size_t n, size_t elem_size) {
+    char *seen = calloc(n, 1);
+    size_t i;
+
+    if (!seen)
+        fatal_error("malloc failed");
+
+    for (i = 0; i < n; ++i) {
+        if (order[i] >= n || seen[order[i]])
+            fatal_error("\n%s returned a bad index at %lu", what, i);
+        seen[order[i]] = 1;
+        memcpy((char *)scratch + i * elem_size,
+               (const char *)orig + order[i] * elem_size, elem_size);
+    }
+
+    if (memcmp(scratch, sorted, n * elem_size)
+            && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+        fatal_error("\n%s produced a bad sort", what);
+
+    free(seen);
+}
+
+/* Run argsort_template() and argsort_ptr_template() on a copy of the data,
+ * which must be left as it was */
+static void validate_argsort(const void *orig, const void *sorted,
+                             void *copy, void *scratch, size_t n,
+                             size_t elem_size) {
+    const size_t index_size = argsort_index_size(&my_def);
+    size_t *order = calloc(n, sizeof(*order));
+    const void **ptrs = malloc(n * sizeof(*ptrs));
+    void *index = malloc(n * index_size);
+    size_t i;
+    int ret;
+
+    if (!order || !ptrs || !index)
+        fatal_error("malloc failed");
+
+    memcpy(copy, orig, n * elem_size);
+
+    ret = argsort_template(&my_def, NULL, 0, copy, n, index, NULL);
+    if (ret)
+        fatal_error("argsort_template returned %d\n", ret);
+
+    if (memcmp(copy, orig, n * elem_size))
+        fatal_error("\nargsort_template modified its input");
+
+    for (i = 0; i < n; ++i)
+        order[i] = index_size == sizeof(uint32_t) ? ((uint32_t *)index)[i]
+                                                  : ((uint64_t *)index)[i];
+    check_argsort("argsort_template", orig, sorted, scratch, order, n,
+                  elem_size);
+
+    ret = argsort_ptr_template(&my_def, NULL, 0, copy, n, ptrs, NULL);
+    if (ret)
+        fatal_error("argsort_ptr_template returned %d\n", ret);
+
+    if (memcmp(copy, orig, n * elem_size))
+        fatal_error("\nargsort_ptr_template modified its input");
+
+    for (i = 0; i < n; ++i)
+        order[i] = ((const char *)ptrs[i] - (const char *)copy) / elem_size;
+    check_argsort("argsort_ptr_template", orig, sorted, scratch, order, n,
+                  elem_size);
+
+    free(index);
+    free(ptrs);
+    free(order);
+}
+
+static int u32_less(const void *a, const void *b) {
+    return *(const uint32_t *)a < *(const uint32_t *)b;
+}
+
+static const struct qsort_def u32_def = {
+    .size          = sizeof(uint32_t),
+    .align         = alignof(uint32_t),
+    .less          = u32_less,
+};
+
+/* an elem_buf of one key, too small for an index entry */
+static uint32_t u32_buf;
+
+static const struct qsort_def u32_buf_def = {
+    .size          = sizeof(uint32_t),
+    .align         = alignof(uint32_t),
+    .less          = u32_less,
+    .elem_buf      = &u32_buf,
+};
+
+/* Check an argsort result of small keys and the canary bytes after the one key
+ * of buffer the argsort was given */
+static void check_argsort_small(const char *what, const struct qsort_def *def,
+                                const void *keys, const size_t *order,
+                                const unsigned char *buf, size_t buf_len,
+                                char *seen, size_t n) {
+    const char *k = keys;
+    size_t i;
+
+    for (i = def->size; i < buf_len; ++i)
+        if (buf[i] != 0xa5)
+            fatal_error("\n%s overran a %lu-byte elem_buf", what, def->size);
+
+    memset(seen, 0, n);
+    for (i = 0; i < n; ++i) {
+        if (order[i] >= n || seen[order[i]]
+                || (i && def->less(&k[order[i] * def->size],
+                                   &k[order[i - 1] * def->size])))
+            fatal_error("\n%s misplaced %lu-byte key %lu", what, def->size, i);
+        seen[order[i]] = 1;
+    }
+}
+
+/* Run argsort_template() and argsort_ptr_template() on keys smaller than their
+ * index entries, each given a buffer of one key followed by canary bytes */
+static gboing_always_inline void
+argsort_small(const struct qsort_def *def, const void *keys, size_t *order,
+              const void **ptrs, void *index, char *seen, size_t n) {
+    alignas(max_align_t) unsigned char buf[32];
+    const size_t index_size = argsort_index_size(def);
+    size_t i;
+    int ret;
+
+    memset(buf, 0xa5, sizeof(buf));
+    ret = argsort_template(def, buf, def->size, keys, n, index, NULL);
+    if (ret)
+        fatal_error("argsort_template returned %d\n", ret);
+
+    for (i = 0; i < n; ++i)
+        order[i] = index_size == sizeof(uint32_t) ? ((uint32_t *)index)[i]
+                                                  : ((uint64_t *)index)[i];
+    check_argsort_small("argsort_template", def, keys, order, buf,
+                        sizeof(buf), seen, n);
+
+    memset(buf, 0xa5, sizeof(buf));
+    ret = argsort_ptr_template(def, buf, def->size, keys, n, ptrs, NULL);
+    if (ret)
+        fatal_error("argsort_ptr_template returned %d\n", ret);
+
+    for (i = 0; i < n; ++i)
+        order[i] = ((const char *)ptrs[i] - (const char *)keys) / def->size;
+    check_argsort_small("argsort_ptr_template", def, keys, order, buf,
+                        sizeof(buf), seen, n);
+}
+
+/* Argsort 1-byte and 4-byte keys, whose elem_buf must also hold an index
+ * entry, and check that an elem_buf of one key is rejected */
+static void validate_argsort_small(size_t n) {
+    uint8_t *keys8 = calloc(n, 1);
+    uint32_t *keys32 = calloc(n, sizeof(*keys32));
+    size_t *order = calloc(n, sizeof(*order));
+    const void **ptrs = malloc(n * sizeof(*ptrs));
+    uint64_t *index = malloc(n * sizeof(*index));
+    char *seen = malloc(n);
+    size_t i;
+    int ret;
+
+    if (!keys8 || !keys32 || !order || !ptrs || !index || !seen)
+        fatal_error("malloc failed");
+
+    for (i = 0; i < n; ++i) {
+        keys8[i] = (uint8_t)(i * 7919 % 251);
+        keys32[i] = (uint32_t)(i * 2654435761u);
+    }
+
+    argsort_small(&byte_def, keys8, order, ptrs, index, seen, n);
+    argsort_small(&u32_def, keys32, order, ptrs, index, seen, n);
+
+    ret = argsort_ptr_template(&u32_buf_def, NULL, 0, keys32, n, ptrs, NULL);
+    if (ret != (sizeof(void *) > sizeof(uint32_t) ? EINVAL : 0))
+        fatal_error("argsort_ptr_template returned %d for a %lu-byte "
+                    "elem_buf\n", ret, sizeof(u32_buf));
+
+    free(seen);
+    free(index);
+    free(ptrs);
+    free(order);
+    free(keys32);
+    free(keys8);
+}
+
+/* Sort the data as a file with ext_sort_template(), with a budget small enough
+ * to need several runs and merge passes: first into a longer file, which must
+ * be truncated to the sorted records, then in place */
+static void validate_ext_sort(const void *orig, const void *sorted,
+                              void *scratch, size_t n, size_t elem_size) {
+    const size_t bytes = n * elem_size;
+    char in_path[] = "/tmp/gboing-test-XXXXXX";
+    char out_path[] = "/tmp/gboing-test-XXXXXX";
+    int in_fd = mkstemp(in_path);
+    int out_fd = mkstemp(out_path);
+    struct stat st;
+    int ret;
+
+    if (in_fd < 0 || out_fd < 0)
+        fatal_error("mkstemp failed");
+    unlink(in_path);
+    unlink(out_path);
+
+    if (pwrite(in_fd, orig, bytes, 0) != (ssize_t)bytes)
+        fatal_error("pwrite failed");
+
+    /* stale data past where the sorted records will end */
+    if (pwrite(out_fd, orig, bytes, 0) != (ssize_t)bytes
+            || pwrite(out_fd, orig, elem_size, bytes) != (ssize_t)elem_size)
+        fatal_error("pwrite failed");
+
+    ret = ext_sort_template(&my_def, in_fd, out_fd, NULL, 16 * elem_size,
+                            NULL);
+    if (ret)
+        fatal_error("ext_sort_template returned %d\n", ret);
+
+    if (fstat(out_fd, &st) || st.st_size != (off_t)bytes)
+        fatal_error("\next_sort_template left %lld bytes in out_fd, not %lu",
+                    (long long)st.st_size, bytes);
+
+    if (pread(out_fd, scratch, bytes, 0) != (ssize_t)bytes)
+        fatal_error("pread failed");
+
+    if (memcmp(scratch, sorted, bytes)
+            && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+        fatal_error("\next_sort_template produced different result than "
+                    "_quicksort");
+
+    close(out_fd);
+
+    ret = ext_sort_template(&my_def, in_fd, in_fd, NULL, 16 * elem_size,
+                            NULL);
+    if (ret)
+        fatal_error("ext_sort_template returned %d\n", ret);
+
+    if (pread(in_fd, scratch, bytes, 0) != (ssize_t)bytes)
+        fatal_error("pread failed");
+
+    close(in_fd);
+
+    if (memcmp(scratch, sorted, bytes)
+            && !equivalent_sort(orig, scratch, sorted, n, elem_size))
+        fatal_error("\next_sort_template produced different result than "
+                    "_quicksort");
+}
+
 /* Make sure that _quicksort_template() is correct given these parameters */
 void validate_sort(size_t n, size_t elem_size, size_t min_align, unsigned int seed) {
     void *data[4];
+    void *threaded;
+    void *sampled;
+    void *merged;
+    void *radixed;
+    void *flagged;
     const char *algo_desc[4] = {"orig", "my_quicksort", "_quicksoft", "qsort_r"};
     const size_t DATA_SIZE = sizeof(data) / sizeof(*data);
     size_t bytes = n * elem_size;
@@ -158,7 +1237,23 @@ void validate_sort(size_t n, size_t elem_size, size_t min_align, unsigned int se
     if (0)
         dump_keys(data[0], n, "BEFORE");
 
+    threaded = aligned_alloc(min_align, bytes);
+    memcpy(threaded, data[0], bytes);
+    sampled = aligned_alloc(min_align, bytes);
+    memcpy(sampled, data[0], bytes);
+    merged = aligned_alloc(min_align, bytes);
+    memcpy(merged, data[0], bytes);
+    radixed = aligned_alloc(min_align, bytes);
+    memcpy(radixed, data[0], bytes);
+    flagged = aligned_alloc(min_align, bytes);
+    memcpy(flagged, data[0], bytes);
+
     my_quicksort(data[1], n, elem_size, NULL, NULL);
+    my_quicksort_mt(threaded, n, elem_size, NULL, NULL);
+    my_sample_sort(sampled, n, elem_size, NULL, NULL);
+    my_mergesort(merged,  n, elem_size, NULL, NULL);
+    my_radix_sort(radixed, n, elem_size, NULL, NULL);
+    my_radix_flag_sort(flagged, n, elem_size, NULL, NULL);
     _quicksort  (data[2], n, elem_size, my_compar_r, NULL);
     qsort_r     (data[3], n, elem_size, my_compar_r, NULL);
 
@@ -169,13 +1264,66 @@ void validate_sort(size_t n, size_t elem_size, size_t min_align, unsigned int se
 
     /* compare result of my_quicksort against results of other algos */
     for (i = 2; i < DATA_SIZE - 1; ++i) {
-        if (memcmp(data[1], data[i], bytes)) {
+        if (memcmp(data[1], data[i], bytes)
+                && (!ORDER_MAY_DIFFER
+                    || !equivalent_sort(data[0], data[1], data[i], n,
+                                        elem_size))) {
             dump_keys(data, n, "");
             fprintf(stderr, "\n");
             fatal_error("\nmy_quicksort produced different result than %s", algo_desc[i]);
         }
     }
 
+    if (memcmp(threaded, data[2], bytes)
+            && !equivalent_sort(data[0], threaded, data[2], n, elem_size))
+        fatal_error("\nmy_quicksort_mt produced different result than %s",
+                    algo_desc[2]);
+
+    if (memcmp(sampled, data[2], bytes)
+            && !equivalent_sort(data[0], sampled, data[2], n, elem_size))
+        fatal_error("\nmy_sample_sort produced different result than %s",
+                    algo_desc[2]);
+
+    /* qsort_r is no longer stable (glibc 2.37), so this only checks the order
+     * of the keys; validate_stable() checks that of equal elements */
+    if (memcmp(merged, data[3], bytes)
+            && !equivalent_sort(data[0], merged, data[3], n, elem_size))
+        fatal_error("\nmy_mergesort produced different result than %s",
+                    algo_desc[3]);
+
+    if (memcmp(radixed, data[3], bytes)
+            && !equivalent_sort(data[0], radixed, data[3], n, elem_size))
+        fatal_error("\nmy_radix_sort produced different result than %s",
+                    algo_desc[3]);
+
+    if (memcmp(flagged, data[3], bytes)
+            && !equivalent_sort(data[0], flagged, data[3], n, elem_size))
+        fatal_error("\nmy_radix_flag_sort produced different result than %s",
+                    algo_desc[3]);
+
+    if (n) {
+        validate_select(data[0], data[2], flagged, n, elem_size);
+        validate_heap(data[0], data[2], flagged, n, elem_size);
+        validate_search(data[0], data[2], flagged, n, elem_size);
+        validate_merge(data[0], data[2], flagged, radixed, n, elem_size);
+        validate_unique(data[0], flagged, radixed, merged, n, elem_size);
+        validate_soa(data[0], data[2], flagged, n, elem_size);
+        validate_soa_small(n);
+        validate_argsort(data[0], data[2], flagged, radixed, n, elem_size);
+        validate_argsort_small(n);
+        validate_presorted(data[0], data[2], flagged, n, elem_size);
+        validate_introsort(n);
+        validate_pivot();
+        validate_ext_sort(data[0], data[2], flagged, n, elem_size);
+        validate_few_keys(data[0], flagged, radixed, merged, n, elem_size);
+        validate_stable(data[0], flagged, radixed, merged, n, elem_size);
+    }
+
+    free (flagged);
+    free (radixed);
+    free (merged);
+    free (sampled);
+    free (threaded);
     for (i = 1; i < DATA_SIZE; ++i)
         free (data[i]);
 }
@@ -310,6 +1458,11 @@ enum TEST_TYPES {
     TEST_QSORT,
     TEST_MSORT,
     TEST_TQSORT,
+    TEST_TQSORT_MT,
+    TEST_TSAMPLE,
+    TEST_TMSORT,
+    TEST_TRADIX,
+    TEST_TFLAG,
     TEST_COUNT
 };
 
@@ -422,11 +1575,22 @@ int main(int argc, char **argv) {
                "min_align      = %lu\n"
                "key_type       = %s%u_t\n"
                "less_fn        = %s\n"
+               "less_true      = %u\n"
                "outline_copy   = %u\n"
                "outline_swap   = %u\n"
                "supply_buffer  = %u\n"
                "max_size_bits  = %u\n"
-               "max_thresh     = %u\n",
+               "max_thresh     = %u\n"
+               "introsort      = %u\n"
+               "block_size     = %u\n"
+               "network        = %u\n"
+               "adaptive       = %u\n"
+               "key_prefix     = %u\n"
+               "pivot          = %u\n"
+               "three_way      = %u\n"
+               "dual_pivot     = %u\n"
+               "threads        = %u\n"
+               "mt_cutoff      = %u\n",
                max_time.tv_sec, max_time.tv_nsec,
                max_iterations,
                elem_count,
@@ -435,11 +1599,22 @@ int main(int argc, char **argv) {
                (size_t)(ALIGN_SIZE),
                GBOING_STRIZE(KEY_SIGN), KEY_BITS,
                GBOING_STRIZE(LESS_FN),
+               LESS_TRUE,
                OUTLINE_COPY,
                OUTLINE_SWAP,
                SUPPLY_BUFFER,
                MAX_SIZE_BITS,
-               MAX_THRESH
+               MAX_THRESH,
+               INTROSORT,
+               BLOCK_SIZE,
+               NETWORK,
+               ADAPTIVE,
+               PREFIX,
+               PIVOT,
+               THREE_WAY,
+               DUAL_PIVOT,
+               THREADS,
+               MT_CUTOFF
                );
     }
 
@@ -454,10 +1629,20 @@ int main(int argc, char **argv) {
     results[TEST_QSORT]  = run_test(arr, 0, _quicksort, "_quicksort");
     results[TEST_MSORT]  = run_test(arr, 0, qsort_r, "qsort_r");
     results[TEST_TQSORT] = run_test(arr, 0, my_quicksort, "my_quicksort");
+    results[TEST_TQSORT_MT] = run_test(arr, 0, my_quicksort_mt, "my_quicksort_mt");
+    results[TEST_TSAMPLE] = run_test(arr, 0, my_sample_sort, "my_sample_sort");
+    results[TEST_TMSORT] = run_test(arr, 0, my_mergesort, "my_mergesort");
+    results[TEST_TRADIX] = run_test(arr, 0, my_radix_sort, "my_radix_sort");
+    results[TEST_TFLAG]  = run_test(arr, 0, my_radix_flag_sort, "my_radix_flag_sort");
 
     if (verbose) {
         fprintf(stderr, "%.2f%% faster than _quicksort\n", results[TEST_TQSORT].ips / results[TEST_QSORT].ips * 100);
         fprintf(stderr, "%.2f%% faster than msort\n", results[TEST_TQSORT].ips / results[TEST_MSORT].ips * 100);
+        fprintf(stderr, "my_quicksort_mt %.2f%% faster than my_quicksort\n", results[TEST_TQSORT_MT].ips / results[TEST_TQSORT].ips * 100);
+        fprintf(stderr, "my_sample_sort %.2f%% faster than my_quicksort\n", results[TEST_TSAMPLE].ips / results[TEST_TQSORT].ips * 100);
+        fprintf(stderr, "my_mergesort %.2f%% faster than msort\n", results[TEST_TMSORT].ips / results[TEST_MSORT].ips * 100);
+        fprintf(stderr, "my_radix_sort %.2f%% faster than msort\n", results[TEST_TRADIX].ips / results[TEST_MSORT].ips * 100);
+        fprintf(stderr, "my_radix_flag_sort %.2f%% faster than msort\n", results[TEST_TFLAG].ips / results[TEST_MSORT].ips * 100);
     }
 
     for (i = 0; i < TEST_COUNT; ++i) {